@@ -0,0 +1,316 @@
+/* Simple86_Linker Archive
+ *
+ * Static libraries for the linker: many object files bundled in
+ * one file, with an index from each name the members define to
+ * the member defining it. The index is a hash table stored in
+ * the file, looked up in place through a read-only mapping.
+ *
+ */
+
+#ifndef SIMULA_ARCHIVE
+#define SIMULA_ARCHIVE 1
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ObjectFile.h"
+
+using namespace std;
+
+// First bytes of an archive, and its format
+#define ARCHIVE_MAGIC "S86A1\0\0\0"
+#define ARCHIVE_MAGIC_SIZE 8
+
+// Layout of an archive, all numbers are 32 bits little endian:
+//   header: magic, memberCount, bucketCount, membersAt, bucketsAt, namesAt, 0
+//   members: per member, nameAt, nameLength, dataAt, dataSize
+//   buckets: per bucket, hash, member, nameAt, nameLength (member is
+//            ARCHIVE_NO_MEMBER in empty buckets)
+//   names: the texts of member and symbol names
+//   data: the members' object files, as they were
+#define ARCHIVE_HEADER_SIZE 32
+#define ARCHIVE_ENTRY_SIZE 16
+#define ARCHIVE_NO_MEMBER 0xFFFFFFFF
+
+// An archive of object files, mapped into memory
+class Archive{
+
+    private:
+        const char* data; // Start of the mapping
+        size_t length; // Bytes mapped
+        uint32_t members; // Number of members
+        uint32_t buckets; // Number of buckets of the index, a power of two
+        uint32_t membersAt, bucketsAt; // Where the tables start
+
+        // Reads the number at offset, the mapping is not aligned
+        uint32_t word(size_t offset){
+            uint32_t value;
+            memcpy(&value, this->data + offset, sizeof(uint32_t));
+            return value;
+        }
+
+        static void putWord(string& out, uint32_t value){
+            for(int b = 0; b < 4; b++){
+                out.push_back((char)(value >> (8 * b)));
+            }
+        }
+
+        static void putWordAt(string& out, size_t offset, uint32_t value){
+            for(int b = 0; b < 4; b++){
+                out[offset + b] = (char)(value >> (8 * b));
+            }
+        }
+
+        // True if [offset, offset + size) is inside the mapping
+        bool inside(uint64_t offset, uint64_t size){
+            return offset <= this->length && size <= this->length - offset;
+        }
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * Archive(string fileName)
+        * Maps the archive read-only and checks its tables are inside it.
+        * ------------------------------------------------------------------------ */
+        Archive(string fileName){
+            struct stat info;
+            int fd = open(fileName.c_str(), O_RDONLY);
+
+            this->data = nullptr;
+            this->length = 0;
+            this->members = 0;
+            this->buckets = 0;
+            if(fd < 0){
+                return;
+            }
+            if(fstat(fd, &info) == 0 && info.st_size >= ARCHIVE_HEADER_SIZE){
+                void* m = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(m != MAP_FAILED){
+                    this->data = (const char*)m;
+                    this->length = info.st_size;
+                }
+            }
+            ::close(fd);
+            if(this->data == nullptr || memcmp(this->data, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) != 0){
+                this->close();
+                return;
+            }
+            this->members = this->word(8);
+            this->buckets = this->word(12);
+            this->membersAt = this->word(16);
+            this->bucketsAt = this->word(20);
+            if((this->buckets & (this->buckets - 1)) != 0
+               || !this->inside(this->membersAt, (uint64_t)this->members * ARCHIVE_ENTRY_SIZE)
+               || !this->inside(this->bucketsAt, (uint64_t)this->buckets * ARCHIVE_ENTRY_SIZE)){
+                this->close();
+                return;
+            }
+            for(uint32_t k = 0; k < this->members; k++){
+                size_t entry = this->membersAt + k * ARCHIVE_ENTRY_SIZE;
+                if(!this->inside(this->word(entry), this->word(entry + 4)) || !this->inside(this->word(entry + 8), this->word(entry + 12))){
+                    this->close();
+                    return;
+                }
+            }
+        }
+
+        ~Archive(){
+            this->close();
+        }
+
+        void close(){
+            if(this->data != nullptr){
+                munmap((void*)this->data, this->length);
+            }
+            this->data = nullptr;
+            this->length = 0;
+            this->members = 0;
+            this->buckets = 0;
+        }
+
+       /* ------------------------------------------------------------------------
+        * static bool isArchive(string fileName)
+        * True if the file starts as an archive does.
+        * ------------------------------------------------------------------------ */
+        static bool isArchive(string fileName){
+            char magic[ARCHIVE_MAGIC_SIZE];
+            ifstream in(fileName.c_str(), ios::in|ios::binary);
+            return in.read(magic, ARCHIVE_MAGIC_SIZE) && memcmp(magic, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) == 0;
+        }
+
+        // The hash of a name in the index, 32 bits FNV-1a
+        static uint32_t hash(const char* text, size_t length){
+            uint32_t h = 2166136261u;
+            for(size_t i = 0; i < length; i++){
+                h ^= (unsigned char)text[i];
+                h *= 16777619u;
+            }
+            return h;
+        }
+
+        bool isOpen(){
+            return this->data != nullptr;
+        }
+
+        uint32_t memberCount(){
+            return this->members;
+        }
+
+        string memberName(uint32_t m){
+            size_t entry = this->membersAt + m * ARCHIVE_ENTRY_SIZE;
+            return string(this->data + this->word(entry), this->word(entry + 4));
+        }
+
+       /* ------------------------------------------------------------------------
+        * const char* memberData(uint32_t m), size_t memberSize(uint32_t m)
+        * The object file of the m-th member, in place. Valid while the
+        * Archive exists, see ObjectFile(const char*, size_t).
+        * ------------------------------------------------------------------------ */
+        const char* memberData(uint32_t m){
+            return this->data + this->word(this->membersAt + m * ARCHIVE_ENTRY_SIZE + 8);
+        }
+
+        size_t memberSize(uint32_t m){
+            return this->word(this->membersAt + m * ARCHIVE_ENTRY_SIZE + 12);
+        }
+
+       /* ------------------------------------------------------------------------
+        * uint32_t find(const string& name)
+        * The member defining name, or ARCHIVE_NO_MEMBER. Probes the index in
+        * place, only the buckets visited are read from the file.
+        * ------------------------------------------------------------------------ */
+        uint32_t find(const string& name){
+            if(this->buckets == 0){
+                return ARCHIVE_NO_MEMBER;
+            }
+            uint32_t h = Archive::hash(name.data(), name.size());
+            for(uint32_t probe = 0; probe < this->buckets; probe++){
+                size_t entry = this->bucketsAt + ((h + probe) & (this->buckets - 1)) * ARCHIVE_ENTRY_SIZE;
+                uint32_t member = this->word(entry + 4);
+                if(member == ARCHIVE_NO_MEMBER){
+                    return ARCHIVE_NO_MEMBER;
+                }
+                uint32_t nameAt = this->word(entry + 8), nameLength = this->word(entry + 12);
+                if(this->word(entry) == h && nameLength == name.size() && this->inside(nameAt, nameLength)
+                   && memcmp(this->data + nameAt, name.data(), nameLength) == 0){
+                    return member < this->members ? member : ARCHIVE_NO_MEMBER;
+                }
+            }
+            return ARCHIVE_NO_MEMBER;
+        }
+
+       /* ------------------------------------------------------------------------
+        * static bool write(ostream& out, vector<string> memberFiles, string& error)
+        * Bundles the object files into an archive written to out. Each member
+        * is named after its file, and indexed by the labels and dws it
+        * defines; a name defined by many members is indexed to the first.
+        * Returns false, describing why in error, if a member can't be read.
+        * ------------------------------------------------------------------------ */
+        static bool write(ostream& out, vector<string> memberFiles, string& error){
+            vector<string> contents(memberFiles.size());
+            vector<string> symbols;
+            vector<uint32_t> owners;
+            unordered_set<string> seen;
+            string names, archive;
+
+            for(size_t m = 0; m < memberFiles.size(); m++){
+                ifstream in(memberFiles[m].c_str(), ios::in|ios::binary);
+                ostringstream buffer;
+                if(!in.is_open()){
+                    error = "File " + memberFiles[m] + " could not be read.";
+                    return false;
+                }
+                buffer << in.rdbuf();
+                contents[m] = buffer.str();
+
+                ObjectFile object(contents[m].data(), contents[m].size());
+                for(size_t k = 0; k < object.recordCount(); k++){
+                    ObjectRecord r = object.record(k);
+                    string name = r.type == InstructionType::VAR ? r.opA.str() : r.id.str();
+                    if(r.fullText.empty() || r.type == InstructionType::INSTRUCTION || name.empty() || !seen.insert(name).second){
+                        continue;
+                    }
+                    symbols.push_back(name);
+                    owners.push_back(m);
+                }
+            }
+
+            uint32_t buckets = 1;
+            while(buckets < 2 * symbols.size()){
+                buckets *= 2;
+            }
+            uint32_t membersAt = ARCHIVE_HEADER_SIZE;
+            uint32_t bucketsAt = membersAt + memberFiles.size() * ARCHIVE_ENTRY_SIZE;
+            uint32_t namesAt = bucketsAt + buckets * ARCHIVE_ENTRY_SIZE;
+
+            archive.append(ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE);
+            Archive::putWord(archive, memberFiles.size());
+            Archive::putWord(archive, buckets);
+            Archive::putWord(archive, membersAt);
+            Archive::putWord(archive, bucketsAt);
+            Archive::putWord(archive, namesAt);
+            Archive::putWord(archive, 0);
+
+            // Member names first, then symbol names, then the members themselves
+            vector<uint32_t> memberNameAt, symbolNameAt;
+            for(string& file : memberFiles){
+                size_t slash = file.find_last_of('/');
+                string base = slash == string::npos ? file : file.substr(slash + 1);
+                memberNameAt.push_back(namesAt + names.size());
+                names += base;
+            }
+            for(string& symbol : symbols){
+                symbolNameAt.push_back(namesAt + names.size());
+                names += symbol;
+            }
+
+            uint32_t dataAt = namesAt + names.size();
+            for(size_t m = 0; m < memberFiles.size(); m++){
+                size_t slash = memberFiles[m].find_last_of('/');
+                Archive::putWord(archive, memberNameAt[m]);
+                Archive::putWord(archive, memberFiles[m].size() - (slash == string::npos ? 0 : slash + 1));
+                Archive::putWord(archive, dataAt);
+                Archive::putWord(archive, contents[m].size());
+                dataAt += contents[m].size();
+            }
+
+            // Open addressing, probing the buckets after the one of the hash
+            size_t table = archive.size();
+            vector<char> used(buckets, 0);
+            for(uint32_t b = 0; b < buckets; b++){
+                Archive::putWord(archive, 0);
+                Archive::putWord(archive, ARCHIVE_NO_MEMBER);
+                Archive::putWord(archive, 0);
+                Archive::putWord(archive, 0);
+            }
+            for(size_t s = 0; s < symbols.size(); s++){
+                uint32_t h = Archive::hash(symbols[s].data(), symbols[s].size());
+                uint32_t b = h & (buckets - 1);
+                while(used[b]){
+                    b = (b + 1) & (buckets - 1);
+                }
+                used[b] = 1;
+                Archive::putWordAt(archive, table + b * ARCHIVE_ENTRY_SIZE, h);
+                Archive::putWordAt(archive, table + b * ARCHIVE_ENTRY_SIZE + 4, owners[s]);
+                Archive::putWordAt(archive, table + b * ARCHIVE_ENTRY_SIZE + 8, symbolNameAt[s]);
+                Archive::putWordAt(archive, table + b * ARCHIVE_ENTRY_SIZE + 12, symbols[s].size());
+            }
+
+            archive += names;
+            for(string& c : contents){
+                archive += c;
+            }
+            out.write(archive.data(), archive.size());
+            return out.good();
+        }
+};
+
+#endif
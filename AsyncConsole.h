@@ -0,0 +1,156 @@
+/* Simple86_Emulator AsyncConsole
+*
+* A Console whose output is formatted and written by a thread of
+* its own: WRITE and DUMP only push their raw words into an
+* SpscRing, so the machine never waits on the stream. A block, from
+* an output device, is pushed whole as one event and written in one
+* go. The output is byte for byte the one of a StreamConsole, in the
+* same order.
+*
+*/
+#ifndef SIMULA_ASYNCCONSOLE
+#define SIMULA_ASYNCCONSOLE 1
+
+#include<cstdint>
+#include<cstring>
+#include<iostream>
+#include<thread>
+#include<atomic>
+#include<chrono>
+#include"Console.h"
+#include"SpscRing.h"
+
+using namespace std;
+
+// AsyncConsole for Simple86
+class AsyncConsole : public Console {
+private:
+    // A WRITE, its word in values[0], the registers of a DUMP, or a block
+    // of count words, a copy the writer deletes.
+    struct Event {
+        int16_t values[DUMP_REGISTERS];
+        bool dump;
+        int16_t* block;
+        size_t count;
+    };
+
+    SpscRing<Event> ring;
+    StreamConsole formatter; // Formats the events, on the writer thread
+    ostream* out;
+    thread writer;
+    atomic<bool> closing;
+    atomic<uint64_t> written; // Events the writer is done with
+    atomic<uint64_t> flushed; // Events written and flushed
+    uint64_t pushed; // Events pushed, by the machine's thread only
+
+    /* ------------------------------------------------------------------------
+    * void writerLoop()
+    * Body of the writer thread. Formats the events in the order they were
+    * pushed, flushing whenever it catches up with the machine, and backs
+    * off while there are none, until the console is closed and drained.
+    * ------------------------------------------------------------------------ */
+    void writerLoop() {
+        Event event;
+        unsigned int idle = 0;
+
+        while (true) {
+            if (this->ring.tryPop(event)) {
+                if (event.block != nullptr) {
+                    this->formatter.writeBlock(event.block, event.count);
+                    delete[] event.block;
+                } else if (event.dump) {
+                    this->formatter.dump(event.values);
+                } else {
+                    this->formatter.write(event.values[0]);
+                }
+                this->written++;
+                idle = 0;
+                continue;
+            }
+            if (idle == 0) {
+                this->out->flush();
+                this->flushed.store(this->written.load());
+            }
+            if (this->closing.load(memory_order_acquire) && this->ring.empty()) {
+                return;
+            }
+            if (++idle < 64) {
+                this_thread::yield();
+            } else {
+                this_thread::sleep_for(chrono::microseconds(50));
+            }
+        }
+    }
+
+    /* ------------------------------------------------------------------------
+    * void push(const Event& event)
+    * Queues an event. When the ring is full, waits for the writer to make
+    * room, so a fast program is held back by its output, never loses it.
+    * ------------------------------------------------------------------------ */
+    void push(const Event& event) {
+        while (!this->ring.tryPush(event)) {
+            this_thread::yield();
+        }
+        this->pushed++;
+    }
+
+public:
+    // Writes to out through a ring of capacity events.
+    AsyncConsole(ostream* out = &cout, size_t capacity = 4096) : ring(capacity), formatter(out, false) {
+        this->out = out;
+        this->closing = false;
+        this->written = 0;
+        this->flushed = 0;
+        this->pushed = 0;
+        this->writer = thread(&AsyncConsole::writerLoop, this);
+    }
+
+    // Writes what is left and stops the writer.
+    ~AsyncConsole() {
+        this->closing.store(true, memory_order_release);
+        this->writer.join();
+        this->out->flush();
+    }
+
+    // Waits until everything pushed so far was written and flushed. The
+    // writer is then idle until the next push.
+    void drain() {
+        while (this->flushed.load() != this->pushed) {
+            this_thread::yield();
+        }
+    }
+
+    // Reads as a StreamConsole does, once the output so far is out, so a
+    // prompt shows before the program waits for its answer.
+    bool read(int16_t& word) {
+        this->drain();
+        return this->formatter.read(word);
+    }
+
+    void write(int16_t word) {
+        Event event;
+        event.values[0] = word;
+        event.dump = false;
+        event.block = nullptr;
+        this->push(event);
+    }
+
+    void writeBlock(const int16_t* words, size_t count) {
+        Event event;
+        event.dump = false;
+        event.block = new int16_t[count];
+        event.count = count;
+        memcpy(event.block, words, count * sizeof(int16_t));
+        this->push(event);
+    }
+
+    void dump(const int16_t registers[DUMP_REGISTERS]) {
+        Event event;
+        memcpy(event.values, registers, sizeof(event.values));
+        event.dump = true;
+        event.block = nullptr;
+        this->push(event);
+    }
+};
+
+#endif
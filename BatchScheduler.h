@@ -0,0 +1,236 @@
+/* Simple86_Emulator BatchScheduler
+ *
+ * Runs many Simple86 machines to completion over a fixed set of
+ * threads, M machines on N threads. Machines run in time slices of
+ * a number of instructions, so a long program can't hold a thread
+ * while short ones wait: after its slice it goes back to the end
+ * of its queue. Each thread has its own queues, one per priority,
+ * and steals from the others' when its own are empty.
+ *
+ */
+
+#ifndef SIMULA_BATCHSCHEDULER
+#define SIMULA_BATCHSCHEDULER 1
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include "Memory.h"
+#include "Execute.h"
+#include "FetchAndDecode.h"
+#include "Console.h"
+#include "Predecoded.h"
+
+using namespace std;
+
+// Priorities of a job, 0 is the most urgent. A job of some priority only
+// runs when no job of a more urgent one is waiting on its thread.
+#define BATCH_PRIORITIES 4
+
+// A machine run by a BatchScheduler, with its program already loaded
+struct BatchJob{
+    Memory* memory;
+    BufferConsole console; // Holds the input words, collects the output words
+    Execute* execute;
+    FetchAndDecode* fetchAndDecode;
+    int priority; // 0 to BATCH_PRIORITIES - 1
+    uint64_t budget; // Instructions the job may run in all, 0 for no limit
+    uint64_t executed; // Instructions run so far
+    function<void(BatchJob*)> done; // Called, on a worker, once it halted or spent its budget
+
+   /* ------------------------------------------------------------------------
+    * BatchJob(Memory* memory, const PredecodedInstruction* records, int32_t count)
+    * A job on a loaded memory, which it takes and deletes, running the count
+    * first words from records, if there are any.
+    * ------------------------------------------------------------------------ */
+    BatchJob(Memory* memory, const PredecodedInstruction* records = nullptr, int32_t count = 0){
+        this->memory = memory;
+        this->execute = new Execute(memory, &this->console);
+        this->fetchAndDecode = new FetchAndDecode(memory, this->execute);
+        if(records != nullptr){
+            this->fetchAndDecode->usePredecoded(records, count);
+        }
+        this->priority = 0;
+        this->budget = 0;
+        this->executed = 0;
+    }
+
+    ~BatchJob(){
+        delete this->fetchAndDecode;
+        delete this->execute;
+        delete this->memory;
+    }
+
+    // Whether the job is over: it halted or spent its budget
+    bool finished(){
+        return this->fetchAndDecode->halted() || (this->budget != 0 && this->executed >= this->budget);
+    }
+};
+
+// The BatchScheduler
+class BatchScheduler{
+
+    private:
+        // The queues of a worker thread
+        struct Worker{
+            mutex lock;
+            deque<BatchJob*> queues[BATCH_PRIORITIES];
+        };
+
+        vector<Worker*> workers;
+        vector<thread> threads;
+        uint64_t slice; // Instructions a job runs before the next one's turn
+        atomic<size_t> queued; // Jobs in the queues
+        atomic<unsigned int> nextWorker; // Where the next submitted job goes
+        atomic<unsigned int> sleeping; // Workers waiting for jobs
+        mutex idleLock; // Guards the sleep of idle workers
+        condition_variable hasWork;
+        bool stopping;
+
+       /* ------------------------------------------------------------------------
+        * void push(unsigned int w, BatchJob* job)
+        * Queues a job at the end of its queue in worker w, waking a sleeping
+        * worker, if there is one, to take or steal it.
+        * ------------------------------------------------------------------------ */
+        void push(unsigned int w, BatchJob* job){
+            {
+                unique_lock<mutex> guard(this->workers[w]->lock);
+                this->workers[w]->queues[job->priority].push_back(job);
+            }
+            this->queued++;
+            if(this->sleeping > 0){
+                unique_lock<mutex> guard(this->idleLock);
+                this->hasWork.notify_one();
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * BatchJob* take(unsigned int w)
+        * The next job for worker w: the oldest of its most urgent queue that
+        * isn't empty or, if all are, the newest of the most urgent queue of
+        * another worker. Null if there are none.
+        * ------------------------------------------------------------------------ */
+        BatchJob* take(unsigned int w){
+            for(int p = 0; p < BATCH_PRIORITIES; p++){
+                Worker* own = this->workers[w];
+                unique_lock<mutex> guard(own->lock);
+                if(!own->queues[p].empty()){
+                    BatchJob* job = own->queues[p].front();
+                    own->queues[p].pop_front();
+                    this->queued--;
+                    return job;
+                }
+            }
+            for(int p = 0; p < BATCH_PRIORITIES; p++){
+                for(size_t k = 1; k < this->workers.size(); k++){
+                    Worker* victim = this->workers[(w + k) % this->workers.size()];
+                    unique_lock<mutex> guard(victim->lock);
+                    if(!victim->queues[p].empty()){
+                        BatchJob* job = victim->queues[p].back();
+                        victim->queues[p].pop_back();
+                        this->queued--;
+                        return job;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void workerLoop(unsigned int w)
+        * Body of worker w: runs a slice of the next job, then either finishes
+        * it or queues it again behind the others, sleeping when there are no
+        * jobs anywhere.
+        * ------------------------------------------------------------------------ */
+        void workerLoop(unsigned int w){
+            while(true){
+                BatchJob* job = this->take(w);
+                if(job == nullptr){
+                    unique_lock<mutex> guard(this->idleLock);
+                    this->sleeping++;
+                    this->hasWork.wait(guard, [this]{ return this->stopping || this->queued > 0; });
+                    this->sleeping--;
+                    if(this->stopping && this->queued == 0){
+                        return;
+                    }
+                    continue;
+                }
+
+                uint64_t slice = this->slice;
+                if(job->budget != 0 && job->budget - job->executed < slice){
+                    slice = job->budget - job->executed;
+                }
+                job->executed += job->fetchAndDecode->run(slice);
+                if(job->finished()){
+                    job->done(job);
+                    delete job;
+                }else{
+                    this->push(w, job);
+                }
+            }
+        }
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * BatchScheduler(unsigned int threads, uint64_t slice)
+        * Starts threads workers (0 means one per hardware thread), switching
+        * jobs every slice instructions.
+        * ------------------------------------------------------------------------ */
+        BatchScheduler(unsigned int threads, uint64_t slice = 10000){
+            if(threads == 0){
+                threads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+            }
+            this->slice = slice > 0 ? slice : 1;
+            this->queued = 0;
+            this->nextWorker = 0;
+            this->sleeping = 0;
+            this->stopping = false;
+            for(unsigned int w = 0; w < threads; w++){
+                this->workers.push_back(new Worker());
+            }
+            for(unsigned int w = 0; w < threads; w++){
+                this->threads.push_back(thread(&BatchScheduler::workerLoop, this, w));
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * ~BatchScheduler()
+        * Runs the jobs submitted to completion and joins every worker.
+        * ------------------------------------------------------------------------ */
+        ~BatchScheduler(){
+            {
+                unique_lock<mutex> guard(this->idleLock);
+                this->stopping = true;
+            }
+            this->hasWork.notify_all();
+            for(thread& t : this->threads){
+                t.join();
+            }
+            for(Worker* w : this->workers){
+                delete w;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * void submit(BatchJob* job)
+        * Queues a job, which the scheduler takes and deletes after calling its
+        * done. Jobs are spread over the workers in turn. Safe to call from any
+        * thread, including from done.
+        * ------------------------------------------------------------------------ */
+        void submit(BatchJob* job){
+            if(job->priority < 0){
+                job->priority = 0;
+            }else if(job->priority >= BATCH_PRIORITIES){
+                job->priority = BATCH_PRIORITIES - 1;
+            }
+            this->push(this->nextWorker++ % this->workers.size(), job);
+        }
+};
+
+#endif
@@ -0,0 +1,131 @@
+/* Simple86_Compiler BuildCache
+ *
+ * A local on-disk cache for the Mounter and the Linker. Each
+ * entry is a file named after a hash of the bytes it was built
+ * from, plus the tool that built it and the tools version, so
+ * unchanged inputs are never processed twice.
+ *
+ */
+
+#ifndef SIMULA_BUILDCACHE
+#define SIMULA_BUILDCACHE 1
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Changes whenever a tool changes what it writes, invalidating old entries
+#define SIMPLE86_TOOLS_VERSION "simple86-6"
+
+using namespace std;
+
+// BuildCache for the Simple86 tools
+class BuildCache{
+
+    private:
+        string directory; // Where the entries are stored
+        atomic<unsigned int> hits; // Lookups that found an entry
+        atomic<unsigned int> misses; // Lookups that did not
+        atomic<unsigned int> sequence; // Distinguishes temporary files of this process
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * BuildCache(string directory)
+        * Uses the given directory as cache, creating it if needed.
+        * ------------------------------------------------------------------------ */
+        BuildCache(string directory){
+            this->directory = directory;
+            this->hits = 0;
+            this->misses = 0;
+            this->sequence = 0;
+            mkdir(directory.c_str(), 0755);
+        }
+
+       /* ------------------------------------------------------------------------
+        * static uint64_t hash(const char* data, size_t length, uint64_t seed)
+        * 64 bits FNV-1a hash of length bytes, continuing from seed.
+        * ------------------------------------------------------------------------ */
+        static uint64_t hash(const char* data, size_t length, uint64_t seed = 14695981039346656037ULL){
+            uint64_t h = seed;
+            for(size_t i = 0; i < length; i++){
+                h ^= (unsigned char)data[i];
+                h *= 1099511628211ULL;
+            }
+            return h;
+        }
+
+       /* ------------------------------------------------------------------------
+        * string keyFor(string tool, const char* data, size_t length)
+        * The name of the entry holding what tool builds from the given bytes.
+        * ------------------------------------------------------------------------ */
+        string keyFor(string tool, const char* data, size_t length){
+            string salt = tool + '/' + SIMPLE86_TOOLS_VERSION + '/';
+            uint64_t h = BuildCache::hash(salt.data(), salt.size());
+            ostringstream key;
+
+            h = BuildCache::hash(data, length, h);
+            key << tool << '-' << hex << h;
+            return key.str();
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool load(string key, string& contents)
+        * Reads the entry into contents. Returns false, and counts a miss, if
+        * there is no such entry.
+        * ------------------------------------------------------------------------ */
+        bool load(string key, string& contents){
+            ifstream entry((this->directory + '/' + key).c_str(), ios::in|ios::binary);
+            if(!entry.is_open()){
+                this->misses++;
+                return false;
+            }
+            ostringstream buffer;
+            buffer << entry.rdbuf();
+            contents = buffer.str();
+            this->hits++;
+            return true;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void store(string key, const string& contents)
+        * Writes an entry. It is written to a temporary file and then renamed,
+        * so concurrent builds never see half written entries.
+        * ------------------------------------------------------------------------ */
+        void store(string key, const string& contents){
+            ostringstream temporary;
+            temporary << this->directory << '/' << key << ".tmp." << getpid() << '.' << this->sequence++;
+            ofstream entry(temporary.str().c_str(), ios::out|ios::binary);
+            if(!entry.is_open()){
+                return;
+            }
+            entry.write(contents.data(), contents.size());
+            entry.close();
+            if(entry.fail() || rename(temporary.str().c_str(), (this->directory + '/' + key).c_str()) != 0){
+                remove(temporary.str().c_str());
+            }
+        }
+
+        unsigned int hitCount(){
+            return this->hits;
+        }
+
+        unsigned int missCount(){
+            return this->misses;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void writeStatistics(ostream& out)
+        * Reports how many lookups were served by the cache.
+        * ------------------------------------------------------------------------ */
+        void writeStatistics(ostream& out){
+            out << "Build cache: " << this->hitCount() << " hits, " << this->missCount() << " misses" << endl;
+        }
+};
+
+#endif
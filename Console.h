@@ -0,0 +1,191 @@
+/* Simple86_Emulator Console
+*
+* Where a Simple86 machine reads and writes its words: READ, WRITE
+* and DUMP go through a Console, the standard streams by default,
+* or word buffers when the machine runs inside a server.
+*
+*/
+#ifndef SIMULA_CONSOLE
+#define SIMULA_CONSOLE 1
+
+#include<cstdint>
+#include<iostream>
+#include<iomanip>
+#include<vector>
+#include<deque>
+#include<mutex>
+#include<sstream>
+
+using namespace std;
+
+// Registers in the order DUMP shows them
+#define DUMP_REGISTERS 8
+
+// Console of a Simple86 machine
+class Console {
+public:
+    virtual ~Console() {}
+
+    // Reads the next input word into word. Returns false if there is none
+    // yet, the machine then waits at its READ until there is.
+    virtual bool read(int16_t& word) = 0;
+
+    // Writes an output word, for WRITE.
+    virtual void write(int16_t word) = 0;
+
+    // Writes count output words at once, as that many WRITEs would, for
+    // the memory-mapped output device.
+    virtual void writeBlock(const int16_t* words, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            this->write(words[i]);
+        }
+    }
+
+    // Shows AX, BX, CX, SP, BP, IP, ZF and SF, for DUMP.
+    virtual void dump(const int16_t registers[DUMP_REGISTERS]) = 0;
+};
+
+// Console on cin and cout, or another output stream, formatted as the
+// Simple86 specification says
+class StreamConsole : public Console {
+private:
+    ostream* out;
+    // Whether each line is flushed as it is written, as endl does.
+    bool lineFlush;
+
+    void endLine() {
+        if (this->lineFlush) {
+            *this->out << endl;
+        } else {
+            *this->out << '\n';
+        }
+    }
+
+    /* ------------------------------------------------------------------------
+    * template<typename T> void writeToOutput(T t)
+    * Prints a given object or type to screen, according to the
+    * format specified at the docs.
+    * ------------------------------------------------------------------------ */
+    template<typename T>
+    void writeToOutput(T t) {
+        *this->out << left << setw(6) << setfill(' ') << t;
+    }
+
+    /* ------------------------------------------------------------------------
+    * void writeHexToOutput(int16_t value)
+    * Prints a given int16_t value, formatted, and in hexadecimal base.
+    * ------------------------------------------------------------------------ */
+    void writeHexToOutput(int16_t value) {
+        *this->out << right << setw(4) << setfill('0') << hex << value << "  ";
+    }
+
+public:
+    // Writes to out, flushing each line unless lineFlush is false.
+    StreamConsole(ostream* out = &cout, bool lineFlush = true) {
+        this->out = out;
+        this->lineFlush = lineFlush;
+    }
+
+    // Words are read in hexadecimal. At the end of the input, reads 0.
+    bool read(int16_t& word) {
+        word = 0;
+        cin >> hex >> word;
+        return true;
+    }
+
+    void write(int16_t word) {
+        this->writeHexToOutput(word);
+        this->endLine();
+    }
+
+    // Formats the words apart, then hands them to the stream in one write,
+    // flushed once.
+    void writeBlock(const int16_t* words, size_t count) {
+        ostringstream block;
+        for (size_t i = 0; i < count; i++) {
+            block << right << setw(4) << setfill('0') << hex << words[i] << "  " << '\n';
+        }
+        string text = block.str();
+        this->out->write(text.data(), text.size());
+        if (this->lineFlush) {
+            this->out->flush();
+        }
+    }
+
+    void dump(const int16_t registers[DUMP_REGISTERS]) {
+        const char* names[DUMP_REGISTERS] = { "AX", "BX", "CX", "SP", "BP", "IP", "ZF", "SF" };
+        for (int r = 0; r < DUMP_REGISTERS; r++) {
+            this->writeToOutput(names[r]);
+        }
+        this->endLine();
+        for (int r = 0; r < DUMP_REGISTERS; r++) {
+            this->writeHexToOutput(registers[r]);
+        }
+        this->endLine();
+    }
+};
+
+// Console on word buffers: input words are taken from a queue, 0 once
+// it is empty, output words, and the registers of each DUMP, appended
+// to a vector
+class BufferConsole : public Console {
+public:
+    deque<int16_t> input;
+    vector<int16_t> output;
+
+    bool read(int16_t& word) {
+        word = 0;
+        if (!this->input.empty()) {
+            word = this->input.front();
+            this->input.pop_front();
+        }
+        return true;
+    }
+
+    void write(int16_t word) {
+        this->output.push_back(word);
+    }
+
+    void writeBlock(const int16_t* words, size_t count) {
+        this->output.insert(this->output.end(), words, words + count);
+    }
+
+    void dump(const int16_t registers[DUMP_REGISTERS]) {
+        this->output.insert(this->output.end(), registers, registers + DUMP_REGISTERS);
+    }
+};
+
+// Console shared by the harts of an SMP machine: each READ, WRITE and
+// DUMP goes whole to the console beneath, one hart at a time
+class SharedConsole : public Console {
+private:
+    Console* console;
+    mutex lock;
+
+public:
+    SharedConsole(Console* console) {
+        this->console = console;
+    }
+
+    bool read(int16_t& word) {
+        lock_guard<mutex> hold(this->lock);
+        return this->console->read(word);
+    }
+
+    void write(int16_t word) {
+        lock_guard<mutex> hold(this->lock);
+        this->console->write(word);
+    }
+
+    void writeBlock(const int16_t* words, size_t count) {
+        lock_guard<mutex> hold(this->lock);
+        this->console->writeBlock(words, count);
+    }
+
+    void dump(const int16_t registers[DUMP_REGISTERS]) {
+        lock_guard<mutex> hold(this->lock);
+        this->console->dump(registers);
+    }
+};
+
+#endif
@@ -11,6 +11,8 @@
 #include<iostream>
 #include<iomanip>
 #include"Memory.h"
+#include"Console.h"
+#include"HostCalls.h"
 
 // Instruction argument types
 #define opN 0 // Empty
@@ -22,6 +24,13 @@
 #define opMI 6 // Memory-Absolute
 #define opRI 7 // Register-Absolute
 #define opI 8 // Absolute
+// Indexed memory, [BX+displacement], FetchAndDecode adds BX to the
+// displacement and turns opRX and opXR into opRM and opMR; opX and opXI
+// reach Execute as the memory word at that address, never indirect
+#define opX 9 // Indexed
+#define opRX 10 // Register-Indexed
+#define opXR 11 // Indexed-Register
+#define opXI 12 // Indexed-Absolute
 
 using namespace std;
 
@@ -29,29 +38,24 @@ class Execute {
 private:
     // Memory module
     Memory* memory;
-
-    /* ------------------------------------------------------------------------
-    * template<typename T> void writeToOutput(T t)
-    * Prints a given object or type to screen, according to the
-    * format specified at the docs.
-    * ------------------------------------------------------------------------ */
-    template<typename T>
-    void writeToOutput(T t) {
-        cout << left << setw(6) << setfill(' ') << t;
-    }
-
-    /* ------------------------------------------------------------------------
-    * void writeHexToOutput(int16_t value)
-    * Prints a given int16_t value, formatted, and in hexadecimal base.
-    * ------------------------------------------------------------------------ */
-    void writeHexToOutput(int16_t value) {
-        cout << right << setw(4) << setfill('0') << hex << value << "  ";
-    }
+    // Where READ, WRITE and DUMP go, the standard streams unless told otherwise.
+    Console* console;
+    StreamConsole standardConsole;
+    // Where HCALL finds its routines, the standard registry unless told otherwise.
+    HostCalls* hostCalls;
 
 public:
-    // Instantiates a Execute object with a pointer to a valid Memory module object.
-    Execute(Memory* mem) {
+    // Instantiates a Execute object with a pointer to a valid Memory module object,
+    // and, optionally, the Console the machine does its IO on.
+    Execute(Memory* mem, Console* con = nullptr) {
         this->memory = mem;
+        this->console = con != nullptr ? con : &this->standardConsole;
+        this->hostCalls = &HostCalls::standard();
+    }
+
+    // Makes HCALL use the routines of calls.
+    void useHostCalls(HostCalls* calls) {
+        this->hostCalls = calls;
     }
 
     /* -----------------------------------------------------------------------
@@ -86,6 +90,7 @@ public:
             memory->setRegister(memory->getRegName(destiny), memory->getRegister(memory->getRegName(source)));
             break;
         case opMI:
+        case opXI:
             memory->writeMemory(destiny, source);
             break;
         case opRI:
@@ -138,6 +143,10 @@ public:
             opB = memory->readMemory(opA);
             memory->writeMemory(opA, opB + source);
             break;
+        case opXI:
+            opA = memory->readMemory(destiny) + source;
+            memory->writeMemory(destiny, opA);
+            break;
         case opRI:
             reg = memory->getRegName(destiny);
             opA = memory->getRegister(reg);
@@ -188,6 +197,10 @@ public:
             memory->writeMemory(opA, opB);
             opA = opB;
             break;
+        case opXI:
+            opA = memory->readMemory(destiny) - source;
+            memory->writeMemory(destiny, opA);
+            break;
         case opRI:
             reg = memory->getRegName(destiny);
             opA = memory->getRegister(reg);
@@ -215,6 +228,7 @@ public:
             memory->setRegister(memory->Register::AX, memory->getRegister(memory->Register::AX)*opA);
             break;
         case opM:
+        case opX:
             opA = memory->readMemory(source);
             opB = memory->getRegister(memory->Register::AL);
             opB *= opA;
@@ -240,6 +254,7 @@ public:
             memory->setRegister(memory->Register::BX, memory->Register::AX%opA);
             break;
         case opM:
+        case opX:
             opA = memory->readMemory(source);
             memory->setRegister(memory->Register::AL, memory->Register::AX / opA);
             memory->setRegister(memory->Register::AH, memory->Register::AX%opA);
@@ -286,6 +301,10 @@ public:
             memory->writeMemory(opA, opB);
             opA = opB;
             break;
+        case opXI:
+            opA = memory->readMemory(destiny) & source;
+            memory->writeMemory(destiny, opA);
+            break;
         case opRI:
             reg = memory->getRegName(destiny);
             opA = memory->getRegister(reg);
@@ -336,6 +355,10 @@ public:
             memory->writeMemory(opA, opB);
             opA = opB;
             break;
+        case opXI:
+            opA = memory->readMemory(destiny) | source;
+            memory->writeMemory(destiny, opA);
+            break;
         case opRI:
             reg = memory->getRegName(destiny);
             opA = memory->getRegister(reg);
@@ -367,6 +390,10 @@ public:
             opA = ~memory->readMemory(opB);
             memory->writeMemory(opB, opA);
             break;
+        case opX:
+            opA = ~memory->readMemory(destiny);
+            memory->writeMemory(destiny, opA);
+            break;
         }
 
         this->updateZFandSF(opA);
@@ -402,6 +429,7 @@ public:
             opA -= opB;
             break;
         case opMI:
+        case opXI:
             opA = memory->readMemory(source1) - source2;
             break;
         case opRI:
@@ -489,6 +517,7 @@ public:
             opA = memory->getRegister(reg);
             break;
         case opM:
+        case opX:
             opA = memory->readMemory(source);
             break;
         case opI:
@@ -515,6 +544,7 @@ public:
             memory->setRegister(reg, opA);
             break;
         case opM:
+        case opX:
             memory->writeMemory(destiny, opA);
             break;
         default:
@@ -530,45 +560,39 @@ public:
     * parameters (done by the FetchAndDecode module).
     * ------------------------------------------------------------------------ */
     void dump() {
-        this->writeToOutput("AX");
-        this->writeToOutput("BX");
-        this->writeToOutput("CX");
-        this->writeToOutput("SP");
-        this->writeToOutput("BP");
-        this->writeToOutput("IP");
-        this->writeToOutput("ZF");
-        this->writeToOutput("SF");
-        cout << endl;
-        this->writeHexToOutput(memory->getRegister(Memory::AX));
-        this->writeHexToOutput(memory->getRegister(Memory::BX));
-        this->writeHexToOutput(memory->getRegister(Memory::CX));
-        this->writeHexToOutput(memory->getRegister(Memory::SP));
-        this->writeHexToOutput(memory->getRegister(Memory::BP));
-        this->writeHexToOutput(memory->getRegister(Memory::IP));
-        this->writeHexToOutput(memory->getRegister(Memory::ZF));
-        this->writeHexToOutput(memory->getRegister(Memory::SF));
-        cout << endl;
+        int16_t registers[DUMP_REGISTERS] = {
+            memory->getRegister(Memory::AX), memory->getRegister(Memory::BX),
+            memory->getRegister(Memory::CX), memory->getRegister(Memory::SP),
+            memory->getRegister(Memory::BP), memory->getRegister(Memory::IP),
+            memory->getRegister(Memory::ZF), memory->getRegister(Memory::SF)
+        };
+        this->console->dump(registers);
     }
 
     /* ------------------------------------------------------------------------
-    * void read(int16_t destiny, int16_t operandType)
+    * bool read(int16_t destiny, int16_t operandType)
     * Implements the Simple86's READ instruction.
     * Arguments must be already decoded and passed correctly to this method's
-    * parameters (done by the FetchAndDecode module).
+    * parameters (done by the FetchAndDecode module). Returns false, changing
+    * nothing, if the Console has no word to read yet.
     * ------------------------------------------------------------------------ */
-    void read(int16_t destiny, int16_t operandType) {
+    bool read(int16_t destiny, int16_t operandType) {
         Memory::Register reg;
-        int16_t input;
+        int16_t input = 0;
 
-        cin >> hex >> input;
+        // Nothing happens until there is a word to read
+        if (!this->console->read(input)) {
+            return false;
+        }
         if (operandType == opR) {
             reg = memory->getRegName(destiny);
             memory->setRegister(reg, input);
-        } else if (operandType == opM) {
+        } else if (operandType == opM || operandType == opX) {
             memory->writeMemory(destiny, input);
         }
 
         this->updateZFandSF(input);
+        return true;
     }
 
     /* ------------------------------------------------------------------------
@@ -584,11 +608,122 @@ public:
         if (operandType == opR) {
             reg = memory->getRegName(source);
             value = memory->getRegister(reg);
-        } else if (operandType == opM) {
+        } else if (operandType == opM || operandType == opX) {
             value = memory->readMemory(source);
         }
-        writeHexToOutput(value);
-        cout << endl;
+        this->console->write(value);
+    }
+
+    /* ------------------------------------------------------------------------
+    * void xchg(int16_t op1, int16_t op2, int16_t operandType)
+    * Implements the Simple86's XCHG instruction: atomically swaps a register
+    * and a memory word, whichever of the two comes first.
+    * Arguments must be already decoded and passed correctly to this method's
+    * parameters (done by the FetchAndDecode module).
+    * ------------------------------------------------------------------------ */
+    void xchg(int16_t op1, int16_t op2, int16_t operandType) {
+        Memory::Register reg;
+        int16_t address;
+
+        if (operandType == opRM) {
+            reg = memory->getRegName(op1);
+            address = op2;
+        } else if (operandType == opMR) {
+            reg = memory->getRegName(op2);
+            address = op1;
+        } else {
+            return;
+        }
+        memory->setRegister(reg, memory->exchangeMemory(address, memory->getRegister(reg)));
+    }
+
+    /* ------------------------------------------------------------------------
+    * void cas(int16_t destiny, int16_t source, int16_t operandType)
+    * Implements the Simple86's CAS instruction: if the memory word destiny
+    * holds AX, atomically writes the source register to it; if not, loads
+    * the word into AX. The flags are those of CMP AX with the word, ZF is
+    * 1 exactly when the write happened.
+    * Arguments must be already decoded and passed correctly to this method's
+    * parameters (done by the FetchAndDecode module).
+    * ------------------------------------------------------------------------ */
+    void cas(int16_t destiny, int16_t source, int16_t operandType) {
+        int16_t expected, observed;
+
+        if (operandType != opMR) {
+            return;
+        }
+        expected = memory->getRegister(Memory::AX);
+        observed = memory->compareExchangeMemory(destiny, expected, memory->getRegister(memory->getRegName(source)));
+        memory->setRegister(Memory::AX, observed);
+        this->updateZFandSF(expected - observed);
+    }
+
+    /* ------------------------------------------------------------------------
+    * void hart(int16_t destiny, int16_t operandType)
+    * Implements the Simple86's HART instruction: loads the hart's number in
+    * the low byte of a register, and the number of harts in the high one.
+    * Arguments must be already decoded and passed correctly to this method's
+    * parameters (done by the FetchAndDecode module).
+    * ------------------------------------------------------------------------ */
+    void hart(int16_t destiny, int16_t operandType) {
+        if (operandType == opR) {
+            memory->setRegister(memory->getRegName(destiny), memory->getHart());
+        }
+    }
+
+    /* ------------------------------------------------------------------------
+    * void fence()
+    * Implements the Simple86's FENCE instruction.
+    * ------------------------------------------------------------------------ */
+    void fence() {
+        memory->fence();
+    }
+
+    /* ------------------------------------------------------------------------
+    * void movs()
+    * Implements the Simple86's MOVS instruction: copies the CX words at AX to
+    * BX, the blocks may overlap. AX and BX are moved past the words copied,
+    * and CX counts the words left, 0 unless a block ran past the end of the
+    * memory, where the copy stops. CX is read as unsigned.
+    * ------------------------------------------------------------------------ */
+    void movs() {
+        int16_t count = memory->getRegister(Memory::CX);
+        int16_t source = memory->getRegister(Memory::AX);
+        int16_t destiny = memory->getRegister(Memory::BX);
+        int32_t moved = memory->moveMemory(destiny, source, (uint16_t)count);
+
+        memory->setRegister(Memory::AX, source + moved);
+        memory->setRegister(Memory::BX, destiny + moved);
+        memory->setRegister(Memory::CX, count - moved);
+    }
+
+    /* ------------------------------------------------------------------------
+    * void stos()
+    * Implements the Simple86's STOS instruction: writes AX to the CX words at
+    * BX. BX is moved past the words written and CX counts the words left,
+    * as for MOVS.
+    * ------------------------------------------------------------------------ */
+    void stos() {
+        int16_t count = memory->getRegister(Memory::CX);
+        int16_t destiny = memory->getRegister(Memory::BX);
+        int32_t written = memory->fillMemory(destiny, memory->getRegister(Memory::AX), (uint16_t)count);
+
+        memory->setRegister(Memory::BX, destiny + written);
+        memory->setRegister(Memory::CX, count - written);
+    }
+
+    /* ------------------------------------------------------------------------
+    * void hcall(int16_t number, int16_t operandType)
+    * Implements the Simple86's HCALL instruction: runs the native routine
+    * registered as number, see HostCalls.h. The machine halts if there is
+    * none, as it can't go on.
+    * Arguments must be already decoded and passed correctly to this method's
+    * parameters (done by the FetchAndDecode module).
+    * ------------------------------------------------------------------------ */
+    void hcall(int16_t number, int16_t operandType) {
+        if (operandType != opI || !this->hostCalls->call((uint16_t)number, memory)) {
+            this->halt();
+        }
     }
 
     /* ------------------------------------------------------------------------
@@ -599,7 +734,7 @@ public:
     * ------------------------------------------------------------------------ */
     void halt() {
         // Causes FetchAndDecode to halt.
-        memory->setRegister(memory->Register::IP, MEMORY_LIMIT + 1);
+        memory->halt();
     }
 };
 
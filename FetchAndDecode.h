@@ -10,6 +10,8 @@
 #include<cstdint>
 #include"Memory.h"
 #include"Execute.h"
+#include"Profile.h"
+#include"Predecoded.h"
 
 // FetchAndDecode for Simple86
 class FetchAndDecode {
@@ -17,15 +19,38 @@ private:
     // Other required machine modules, necessary for this module to work.
     Memory* memory;
     Execute* exec;
+    // Counts what runs, if a profile was asked for.
+    Profile* profile;
+    // Records of the predecoded section of the program, if it has one.
+    const PredecodedInstruction* predecoded;
+    int32_t predecodedCount;
+    // Whether the last run stopped at a READ with no input yet.
+    bool waiting;
 
 public:
     // Receives the other machines components at the object's creation.
     // The Memory pointer points to a Memory object that is going to be constantly
     // operated and changed, and the Execute pointer points to a Execute instance
-    // that is going to be used to execute each instruction.
-    FetchAndDecode(Memory* mem, Execute* alu) {
+    // that is going to be used to execute each instruction. The Profile
+    // pointer, if not null, points to a Profile updated at each instruction.
+    FetchAndDecode(Memory* mem, Execute* alu, Profile* prof = nullptr) {
         this->memory = mem;
         this->exec = alu;
+        this->profile = prof;
+        this->predecoded = nullptr;
+        this->predecodedCount = 0;
+        this->waiting = false;
+    }
+
+    /* ------------------------------------------------------------------------
+    * void usePredecoded(const PredecodedInstruction* records, int32_t count)
+    * Runs the count first words of code from the given records instead of
+    * decoding them, as long as the program doesn't write over its code.
+    * ------------------------------------------------------------------------ */
+    void usePredecoded(const PredecodedInstruction* records, int32_t count) {
+        this->predecoded = records;
+        this->predecodedCount = count;
+        memory->protectCode(count);
     }
 
     /* ------------------------------------------------------------------------
@@ -34,7 +59,7 @@ public:
     * lenght is equal to 16 bits.
     * ------------------------------------------------------------------------ */
     bool is16bitsInstruction(int8_t opCode) {
-        return opCode == 14 || opCode == 17 || opCode == 20;
+        return opCode == 14 || opCode == 17 || opCode == 20 || opCode == 24 || opCode == 25 || opCode == 26;
     }
 
     /* ------------------------------------------------------------------------
@@ -43,7 +68,7 @@ public:
     * lenght is equal to 32 bits.
     * ------------------------------------------------------------------------ */
     bool is32bitsInstruction(int8_t opCode) {
-        return opCode == 4 || opCode == 5 || opCode == 7 || (opCode >= 10 && opCode <= 13) || opCode == 15 || opCode == 16 || opCode == 18 || opCode == 19;
+        return opCode == 4 || opCode == 5 || opCode == 7 || (opCode >= 10 && opCode <= 13) || opCode == 15 || opCode == 16 || opCode == 18 || opCode == 19 || opCode == 23 || opCode == 27;
     }
 
     /* ------------------------------------------------------------------------
@@ -52,7 +77,25 @@ public:
     * lenght is equal to 48 bits.
     * ------------------------------------------------------------------------ */
     bool is48bitsInstruction(int8_t opCode) {
-        return opCode == 1 || opCode == 2 || opCode == 3 || opCode == 6 || opCode == 8 || opCode == 9;
+        return opCode == 1 || opCode == 2 || opCode == 3 || opCode == 6 || opCode == 8 || opCode == 9 || opCode == 21 || opCode == 22;
+    }
+
+    /* ------------------------------------------------------------------------
+    * void resolveIndexed(int16_t& op1, int16_t& op2, int8_t& operandType)
+    * Adds BX to the displacement of an indexed operand. With a register
+    * the operand is the memory one at that address; alone or with an
+    * immediate it stays indexed, as Execute reads opM and opMI indirectly
+    * for some instructions where an indexed operand is always direct.
+    * ------------------------------------------------------------------------ */
+    void resolveIndexed(int16_t& op1, int16_t& op2, int8_t& operandType) {
+        int16_t base = memory->getRegister(memory->Register::BX);
+        switch (operandType) {
+        case opX: op1 += base; break;
+        case opRX: op2 += base; operandType = opRM; break;
+        case opXR: op1 += base; operandType = opMR; break;
+        case opXI: op1 += base; break;
+        default: break;
+        }
     }
 
     /* ------------------------------------------------------------------------
@@ -62,24 +105,75 @@ public:
     * coordinating, accordingly, with the other machine's modules.
     * ------------------------------------------------------------------------ */
     void initMachine() {
+        this->run(0);
+    }
+
+    // Returns true once the program halted, or ran past the end of the memory.
+    bool halted() {
+        return memory->isHalted() || (uint16_t)memory->getRegister(memory->Register::IP) >= memory->getSize();
+    }
+
+    // Returns true if the last run stopped at a READ, waiting for input.
+    bool waitingForInput() {
+        return this->waiting;
+    }
+
+    /* ------------------------------------------------------------------------
+    * uint64_t run(uint64_t budget)
+    * Executes the program from IP until it halts, until a READ finds no input
+    * yet or, if budget is not 0, until budget instructions ran. Returns the
+    * instructions executed. A stopped machine goes on from where it was if
+    * run again, a waiting one running its READ again.
+    * ------------------------------------------------------------------------ */
+    uint64_t run(uint64_t budget) {
+        if (memory->getSize() == MEMORY_LIMIT) {
+            return this->runLoop<MEMORY_LIMIT>(budget);
+        }
+        return this->runLoop<0>(budget);
+    }
+
+    /* ------------------------------------------------------------------------
+    * template<int32_t Size> uint64_t runLoop(uint64_t budget)
+    * The loop of run, for a memory of Size words, or of any size if Size is
+    * 0. A known Size keeps the bounds constant, and lets HLT's IP past the
+    * end stop the loop alone: a memory of 64K words has no such IP, so the
+    * loop of any size asks the memory whether it halted too.
+    * ------------------------------------------------------------------------ */
+    template<int32_t Size>
+    uint64_t runLoop(uint64_t budget) {
         // Flux control variables
-        int16_t i = 0;
+        const int32_t size = Size != 0 ? Size : memory->getSize();
+        uint16_t i = 0;
         int16_t op1, op2;
         int8_t opCode;
         int8_t operandType;
+        int16_t next;
+        uint64_t executed = 0;
 
-
+        this->waiting = false;
         i = memory->getRegister(memory->Register::IP);
 
-        while (i < MEMORY_LIMIT) {
+        while (i < size && (Size != 0 || !memory->isHalted()) && (budget == 0 || executed < budget)) {
+
+            if (i < this->predecodedCount && (this->predecoded[i].flags & PREDECODED_INSTRUCTION) && !memory->isCodeModified()) {
+                // Takes the instruction already decoded
+                opCode = this->predecoded[i].opCode;
+                operandType = this->predecoded[i].operandType;
+                op1 = this->predecoded[i].op1;
+                op2 = this->predecoded[i].op2;
+            } else {
+                // Reads the instruction's opCode and operandType
+                opCode = (int8_t)(memory->readMemory(i) >> 8);
+                operandType = (int8_t)memory->readMemory(i);
 
-            // Reads the instruction's opCode and operandType
-            opCode = (int8_t)(memory->readMemory(i) >> 8);
-            operandType = (int8_t)memory->readMemory(i);
-            
-            // Reads the instruction's arguments
-            op1 = i + 1 < MEMORY_LIMIT ? memory->readMemory(i + 1) : 0;
-            op2 = i + 2 < MEMORY_LIMIT ? memory->readMemory(i + 2) : 0;
+                // Reads the instruction's arguments
+                op1 = i + 1 < size ? memory->readMemory(i + 1) : 0;
+                op2 = i + 2 < size ? memory->readMemory(i + 2) : 0;
+            }
+
+            if (operandType >= opX) {
+                this->resolveIndexed(op1, op2, operandType);
+            }
 
             // Verifies the instruction's lenght and points the IP register to the next instruction.
             if (this->is16bitsInstruction(opCode)) {
@@ -89,6 +183,7 @@ public:
             } else if (this->is48bitsInstruction(opCode)) {
                 memory->setRegister(memory->Register::IP, memory->getRegister(memory->Register::IP) + 3);
             }
+            next = memory->getRegister(memory->Register::IP);
 
             // Passes the instruction to the Execute module, according to it's opCode.
             switch (opCode) {
@@ -102,8 +197,17 @@ public:
             case 13: exec->call(op1); break;
             case 15: exec->push(op1, operandType); break;
             case 16: exec->pop(op1, operandType); break;
-            case 18: exec->read(op1, operandType); break;
+            case 18:
+                if (!exec->read(op1, operandType)) {
+                    // Suspends at the READ, it runs again once there is input
+                    memory->setRegister(memory->Register::IP, i);
+                    this->waiting = true;
+                    return executed;
+                }
+                break;
             case 19: exec->write(op1, operandType); break;
+            case 23: exec->hart(op1, operandType); break;
+            case 27: exec->hcall(op1, operandType); break;
                 // 48 bits
             case 1: exec->mov(op1, op2, operandType); break;
             case 2: exec->add(op1, op2, operandType); break;
@@ -111,17 +215,27 @@ public:
             case 6: exec->binaryAnd(op1, op2, operandType); break;
             case 8: exec->binaryOr(op1, op2, operandType); break;
             case 9: exec->cmp(op1, op2, operandType); break;
+            case 21: exec->xchg(op1, op2, operandType); break;
+            case 22: exec->cas(op1, op2, operandType); break;
                 // 16 bits
             case 14: exec->ret(); break;
             case 17: exec->dump(); break;
             case 20: exec->halt(); break;
+            case 24: exec->fence(); break;
+            case 25: exec->movs(); break;
+            case 26: exec->stos(); break;
             default: break;
             }
+            // Counts the instruction and, for JZ and JS, whether it jumped.
+            if (this->profile != nullptr) {
+                this->profile->executed(i, (opCode == 11 || opCode == 12) && memory->getRegister(memory->Register::IP) != next);
+            }
             // Goes to the next instruction pointed by the IP register, or halts if
-            // IP > MEMORY_LIMIT.
+            // IP is past the end of the memory.
             i = memory->getRegister(memory->Register::IP);
-
+            executed++;
         }
+        return executed;
     }
 };
 
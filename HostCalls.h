@@ -0,0 +1,129 @@
+/* Simple86_Emulator HostCalls
+*
+* The native routines a Simple86 program reaches with HCALL n: a
+* registry from n to a C++ function run on the machine's Memory.
+*
+* Calling convention: the arguments are in AX, BX and CX, the result,
+* if any, is left in AX. A routine reads and writes the registers and
+* the words of the machine only through its Memory, with getRegister,
+* setRegister, readMemory, writeMemory and the block methods, so a
+* write over the code and, in SMP mode, the memory model are kept. It
+* must not touch IP, SP or BP; the flags and the other registers are
+* its to change. It runs on the machine's thread, and the machine goes
+* on once it returns, with the instruction after the HCALL.
+*
+*/
+#ifndef SIMULA_HOSTCALLS
+#define SIMULA_HOSTCALLS 1
+
+#include<cstdint>
+#include<vector>
+#include<algorithm>
+#include<functional>
+#include"Memory.h"
+
+using namespace std;
+
+// A native routine, see the calling convention above
+typedef function<void(Memory*)> HostFunction;
+
+// The routines of the standard registry
+#define HOSTCALL_DOT 0 // AX = sum of MEM[AX+i] * MEM[BX+i], for i < CX
+#define HOSTCALL_SORT 1 // Sorts the CX words at BX, ascending
+#define HOSTCALL_CHECKSUM 2 // AX = Fletcher-16 of the CX words at BX
+
+// Registry of host calls for Simple86
+class HostCalls {
+private:
+    vector<HostFunction> functions; // Indexed by n, empty if nothing is registered
+
+    // The multiply-accumulate of HOSTCALL_DOT, wrapping as MUL and ADD do.
+    static void dot(Memory* memory) {
+        int16_t a = memory->getRegister(Memory::AX);
+        int16_t b = memory->getRegister(Memory::BX);
+        uint16_t count = memory->getRegister(Memory::CX);
+        int32_t n = min(memory->fitting(a, count), memory->fitting(b, count));
+        int16_t sum = 0;
+
+        for (int32_t i = 0; i < n; i++) {
+            sum += memory->readMemory(a + i) * memory->readMemory(b + i);
+        }
+        memory->setRegister(Memory::AX, sum);
+    }
+
+    // The sort of HOSTCALL_SORT, the words read as signed.
+    static void sort(Memory* memory) {
+        int16_t at = memory->getRegister(Memory::BX);
+        int32_t n = memory->fitting(at, memory->getRegister(Memory::CX));
+        vector<int16_t> block(n);
+
+        for (int32_t i = 0; i < n; i++) {
+            block[i] = memory->readMemory(at + i);
+        }
+        std::sort(block.begin(), block.end());
+        for (int32_t i = 0; i < n; i++) {
+            memory->writeMemory(at + i, block[i]);
+        }
+    }
+
+    // The checksum of HOSTCALL_CHECKSUM: the two Fletcher sums, modulo 255,
+    // of the words read as unsigned, the second one in the high byte.
+    static void checksum(Memory* memory) {
+        int16_t at = memory->getRegister(Memory::BX);
+        int32_t n = memory->fitting(at, memory->getRegister(Memory::CX));
+        uint32_t low = 0, high = 0;
+
+        for (int32_t i = 0; i < n; i++) {
+            low = (low + (uint16_t)memory->readMemory(at + i)) % 255;
+            high = (high + low) % 255;
+        }
+        memory->setRegister(Memory::AX, (int16_t)((high << 8) | low));
+    }
+
+public:
+    // An empty registry.
+    HostCalls() {
+    }
+
+    /* ------------------------------------------------------------------------
+    * static HostCalls& standard()
+    * The registry machines use unless given another one, holding the
+    * routines of HOSTCALL_DOT, HOSTCALL_SORT and HOSTCALL_CHECKSUM. More can
+    * be defined in it before the machines start.
+    * ------------------------------------------------------------------------ */
+    static HostCalls& standard() {
+        static HostCalls calls = HostCalls::withStandardRoutines();
+        return calls;
+    }
+
+    static HostCalls withStandardRoutines() {
+        HostCalls calls;
+        calls.define(HOSTCALL_DOT, HostCalls::dot);
+        calls.define(HOSTCALL_SORT, HostCalls::sort);
+        calls.define(HOSTCALL_CHECKSUM, HostCalls::checksum);
+        return calls;
+    }
+
+    // Registers function as host call n, in place of any before it. Not to
+    // be called while a machine using the registry runs.
+    void define(uint16_t n, HostFunction function) {
+        if (n >= this->functions.size()) {
+            this->functions.resize(n + 1);
+        }
+        this->functions[n] = function;
+    }
+
+    /* ------------------------------------------------------------------------
+    * bool call(uint16_t n, Memory* memory)
+    * Runs host call n on memory. Returns false if none is registered as n.
+    * ------------------------------------------------------------------------ */
+    bool call(uint16_t n, Memory* memory) {
+        if (n >= this->functions.size() || !this->functions[n]) {
+            return false;
+        }
+        this->functions[n](memory);
+        return true;
+    }
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include <sstream>
 #include <algorithm>
 #include <cstdint>
+#include <stdexcept>
 
 using namespace std;
 
@@ -23,7 +24,8 @@ enum InstructionType{
     VAR
 };
 
-//  The nine types of instruction parameters
+//  The types of instruction parameters. X is an indexed memory operand,
+//  [BX] or [BX+displacement], the word at BX plus the displacement.
 enum OperandType{
     N = 0,
     R = 1,
@@ -33,7 +35,11 @@ enum OperandType{
     RR = 5,
     MI = 6,
     RI = 7,
-    I = 8
+    I = 8,
+    X = 9,
+    RX = 10,
+    XR = 11,
+    XI = 12
 };
 
 // The instructions
@@ -58,6 +64,13 @@ enum InstructionCode{
     RET = 14,
     DUMP = 17,
     HALT = 20,
+    XCHG = 21, // Atomic exchange of a register and a memory word
+    CAS = 22, // Atomic compare-and-swap of a memory word against AX
+    HART = 23, // Reads the hart id and the number of harts
+    FENCE = 24, // Orders the memory accesses before it and after it
+    MOVS = 25, // Copies CX words from AX on to BX on
+    STOS = 26, // Fills CX words from BX on with AX
+    HCALL = 27, // Runs a native routine, see HostCalls.h
     NOPE = 99 // Means something is not a instruction
 };
 
@@ -90,7 +103,7 @@ class Instruction{
         * InstructionCode getInstructionCode(string id)
         * Receives a string and returns the equivalent instruction code.
         * ------------------------------------------------------------------------ */
-        InstructionCode getInstructionCode(string id){
+        static InstructionCode getInstructionCode(string id){
             if(id == "mov") return InstructionCode::MOV;
             if(id == "add") return InstructionCode::ADD;
             if(id == "sub") return InstructionCode::SUB;
@@ -111,6 +124,13 @@ class Instruction{
             if(id == "ret") return InstructionCode::RET;
             if(id == "dump") return InstructionCode::DUMP;
             if(id == "hlt") return InstructionCode::HALT;
+            if(id == "xchg") return InstructionCode::XCHG;
+            if(id == "cas") return InstructionCode::CAS;
+            if(id == "hart") return InstructionCode::HART;
+            if(id == "fence") return InstructionCode::FENCE;
+            if(id == "movs") return InstructionCode::MOVS;
+            if(id == "stos") return InstructionCode::STOS;
+            if(id == "hcall") return InstructionCode::HCALL;
             return InstructionCode::NOPE;
         }
 
@@ -118,7 +138,7 @@ class Instruction{
         * RegisterCode getRegisterCode(string id)
         * Receives a string and returns the equivalent register code.
         * ------------------------------------------------------------------------ */
-        RegisterCode getRegisterCode(string id){
+        static RegisterCode getRegisterCode(string id){
             if(id == "al") return RegisterCode::AL;
             if(id == "ah") return RegisterCode::AH;
             if(id == "ax") return RegisterCode::AX;
@@ -135,14 +155,16 @@ class Instruction{
         * int16_t getInstructionSize(InstructionCode code)
         * Receives a InstructionCode and returns it's size in bits.
         * ------------------------------------------------------------------------ */
-        int16_t getInstructionSize(InstructionCode code){
+        static int16_t getInstructionSize(InstructionCode code){
             switch(code){ // without breaks, a switch case falls to the cases bellow.
                 case InstructionCode::MOV:
                 case InstructionCode::ADD:
                 case InstructionCode::SUB:
                 case InstructionCode::AND:
                 case InstructionCode::OR:
-                case InstructionCode::CMP: return 48;
+                case InstructionCode::CMP:
+                case InstructionCode::XCHG:
+                case InstructionCode::CAS: return 48;
                 case InstructionCode::MUL:
                 case InstructionCode::DIV:
                 case InstructionCode::NOT:
@@ -153,10 +175,15 @@ class Instruction{
                 case InstructionCode::PUSH:
                 case InstructionCode::POP:
                 case InstructionCode::READ:
-                case InstructionCode::WRITE: return 32;
+                case InstructionCode::WRITE:
+                case InstructionCode::HART:
+                case InstructionCode::HCALL: return 32;
                 case InstructionCode::RET:
                 case InstructionCode::DUMP:
-                case InstructionCode::HALT: return 16;
+                case InstructionCode::HALT:
+                case InstructionCode::FENCE:
+                case InstructionCode::MOVS:
+                case InstructionCode::STOS: return 16;
                 default: return 0;
             }
         }
@@ -166,7 +193,7 @@ class Instruction{
         * OperandType determinOperandType(string a, string b)
         * Receives the instruction operands and returns their combination type.
         * ------------------------------------------------------------------------ */
-        OperandType determinOperandType(string a, string b){
+        static OperandType determinOperandType(string a, string b){
             char opAType = '0'; // 0 means no operand
             char opBType = '0';
             string typeStr = "";
@@ -176,6 +203,8 @@ class Instruction{
                     opAType = 'I'; // Immediate
                 }else if(a.at(0) == '_'){
                     opAType = 'M'; // Memory
+                }else if(a.at(0) == '['){
+                    opAType = 'X'; // Indexed memory
                 }else{
                     opAType = 'R'; // Register
                 }
@@ -185,6 +214,8 @@ class Instruction{
                         opBType = 'M';
                     }else if(b.at(0) == '0'){
                         opBType = 'I';
+                    }else if(b.at(0) == '['){
+                        opBType = 'X';
                     }else{
                         opBType = 'R';
                     }
@@ -214,6 +245,14 @@ class Instruction{
                 return OperandType::RM;
             }else if(typeStr == "RR"){
                 return OperandType::RR;
+            }else if(typeStr == "X0"){
+                return OperandType::X;
+            }else if(typeStr == "RX"){
+                return OperandType::RX;
+            }else if(typeStr == "XR"){
+                return OperandType::XR;
+            }else if(typeStr == "XI"){
+                return OperandType::XI;
             }
 
             // if no operand
@@ -221,6 +260,28 @@ class Instruction{
         }
 
 
+       /* ------------------------------------------------------------------------
+        * string indexDisplacement(string operand)
+        * Receives an indexed operand, [bx] or [bx+displacement], and returns its
+        * displacement: a name, or a hexa number starting with 0, as immediates
+        * do. Other operands are returned as they are.
+        * ------------------------------------------------------------------------ */
+        static string indexDisplacement(string operand){
+            if(operand.empty() || operand.at(0) != '['){
+                return operand;
+            }
+            if(operand == "[bx]"){
+                return "0";
+            }
+            if(operand.size() > 5 && operand.compare(0, 4, "[bx+") == 0 && operand.at(operand.size() - 1) == ']'){
+                string displacement = operand.substr(4, operand.size() - 5);
+                if(displacement.at(0) == '_' || displacement.at(0) == '0'){
+                    return displacement;
+                }
+            }
+            throw invalid_argument("Only [BX] and [BX+displacement] index the memory, not " + operand);
+        }
+
         Instruction(){
         }
 
@@ -269,6 +330,14 @@ class Instruction{
             }
 
             this->opType = this->determinOperandType(this->opA,this->opB);
+            // Indexed operands are kept as their displacement, the operand type
+            // tells they are indexed
+            this->opA = indexDisplacement(this->opA);
+            this->opB = indexDisplacement(this->opB);
+            if((this->code == InstructionCode::JUMP || this->code == InstructionCode::JZ || this->code == InstructionCode::JS
+                || this->code == InstructionCode::CALL) && this->opType == OperandType::X){
+                throw invalid_argument("Jumps and calls take a name, not " + this->fullText);
+            }
             this->size = getInstructionSize(this->code);
             this->address = 0; // Will be fixed by the compiler
         }
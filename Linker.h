@@ -15,7 +15,20 @@
 #include <cstdint>
 #include <vector>
 #include <iomanip>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <utility>
 #include "Instruction.h"
+#include "Program.h"
+#include "ObjectFile.h"
+#include "ModuleLayout.h"
+#include "BuildCache.h"
+#include "ThreadPool.h"
+#include "Profile.h"
+#include "Archive.h"
+#include "Predecoded.h"
 
 using namespace std;
 
@@ -24,171 +37,836 @@ class Linker{
 
     private:
         vector<string> inputs; // Input modules object files
-        ofstream* output; // outputfile
-        vector<Instruction> program; // Program is an array of Instructions
+        vector<string> libraries; // Input archives, members are linked only if needed
+        unordered_map<string, const string*> memoryModules; // Modules given in memory, by name
+        ostream* output; // outputfile, or any stream taking the executable
+        Program program; // The program, in the compact representation
         int16_t programSizeInBytes; // Total number of bytes this program has
         bool verboseEnabled; // -v flag
+        ThreadPool* pool; // Workers loading, patching and encoding modules
+        BuildCache* cache; // Keeps module layouts between builds, may be null
+        bool gcEnabled; // --gc flag
+        size_t inlineBudget; // --inline BYTES, 0 means no inlining
+        string profileName; // --profile-use FILE, empty without
+        vector<uint64_t> executions; // Per instruction, times it ran in the profile, empty without
+        bool predecodeEnabled; // --predecode flag
 
     public:
 
        /* ------------------------------------------------------------------------
-        * Linker(ifstream* input, ofstream* output, bool verboseEnabled)
-        * Instantializes a Linker object that knows it's IO files
+        * Linker(vector<string> inputs, ostream* output, bool verboseEnabled, unsigned int jobs,
+        *        BuildCache* cache, bool gcEnabled, size_t inlineBudget, string profileName)
+        * Instantializes a Linker object that knows it's IO files, how many
+        * threads it may use (0 means one per hardware thread), optionally,
+        * a build cache for incremental links, the --gc flag, the largest
+        * routine body to inline, in bytes, and a profile to optimize for.
         * ------------------------------------------------------------------------ */
-        Linker(vector<string> inputs, ofstream* output, bool verboseEnabled){
-            this->inputs = inputs;
+        Linker(vector<string> inputs, ostream* output, bool verboseEnabled, unsigned int jobs = 0, BuildCache* cache = nullptr,
+               bool gcEnabled = false, size_t inlineBudget = 0, string profileName = ""){
+            // Archives are told apart from modules by their first bytes
+            for(string& name : inputs){
+                if(Archive::isArchive(name)){
+                    this->libraries.push_back(name);
+                }else{
+                    this->inputs.push_back(name);
+                }
+            }
             this->output = output;
             this->program.clear();
             this->programSizeInBytes = 0;
-            this->verboseEnabled = verboseEnabled;            
+            this->verboseEnabled = verboseEnabled;
+            this->pool = new ThreadPool(jobs);
+            this->cache = cache;
+            this->gcEnabled = gcEnabled;
+            this->inlineBudget = inlineBudget;
+            this->profileName = profileName;
+            this->predecodeEnabled = false;
+        }
+
+        ~Linker(){
+            delete this->pool;
         }
 
        /* ------------------------------------------------------------------------
-        * void readProgram(ifstream* input)
-        * Reads all the object files received by parameter and populates the program
-        * vector.
+        * void readProgram(vector<string> inputStrings)
+        * Reads all the object files received by parameter and populates the
+        * program. Modules are loaded in parallel, each one with addresses relative
+        * to its own start, then moved to their base address, given by the sum of
+        * the sizes of the modules before them.
         * ------------------------------------------------------------------------ */
         void readProgram(vector<string> inputStrings){
+            vector<Program> modules(inputStrings.size());
+            vector<int16_t> moduleSizes(inputStrings.size(), 0);
+            vector<char> loaded(inputStrings.size(), 0);
+
             this->program.clear();
-            for(string& i : inputStrings){
-                linkModule(i);
+            this->pool->parallelFor(inputStrings.size(), [&](size_t begin, size_t end){
+                for(size_t m = begin; m < end; m++){
+                    ObjectFile* object = this->openModule(inputStrings[m]);
+                    loaded[m] = this->loadModule(object, modules[m], moduleSizes[m]);
+                    delete object;
+                }
+            });
+
+            // Prefix sum over the module sizes, reported in command line order
+            for(size_t m = 0; m < modules.size(); m++){
+                if(!loaded[m]){
+                    cerr << "File " << inputStrings[m] << " could not be read. Ignoring this module, this may produce unwanted results and errors." << endl;
+                }
+                this->program.append(modules[m], this->programSizeInBytes / 2);
+                this->programSizeInBytes += moduleSizes[m];
             }
         }
 
         /* ------------------------------------------------------------------------
-        * int linkModule(string inputName)
-        * Receives an name of a module object file. It appends its binary code
-        * at the end of the current program and fixes the addresses. The module
-        * file must be produced by the Mounter provided in this project, it's output
-        * is formatted and accepted by this linker.
+        * void provideModule(string name, const string* bytes)
+        * Makes the input module called name be read from bytes, an object
+        * kept in memory, instead of a file. The bytes must outlive link().
+        * ------------------------------------------------------------------------ */
+        void provideModule(string name, const string* bytes){
+            this->memoryModules[name] = bytes;
+        }
+
+       /* ------------------------------------------------------------------------
+        * ObjectFile* openModule(const string& name)
+        * Opens an input module, from memory if it was provided, else mapping
+        * its file. The caller deletes it.
+        * ------------------------------------------------------------------------ */
+        ObjectFile* openModule(const string& name){
+            unordered_map<string, const string*>::const_iterator found = this->memoryModules.find(name);
+            if(found != this->memoryModules.end()){
+                return new ObjectFile(found->second->data(), found->second->size());
+            }
+            return new ObjectFile(name);
+        }
+
+       /* ------------------------------------------------------------------------
+        * void enablePredecoded()
+        * Makes the executable carry a predecoded section, see Predecoded.h.
+        * ------------------------------------------------------------------------ */
+        void enablePredecoded(){
+            this->predecodeEnabled = true;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void pullArchiveMembers(Program& instructions)
+        * Adds to the program the archive members defining names the program
+        * uses but doesn't define, and, in turn, the members those need. Each
+        * name is looked up in the archives in command line order; members are
+        * placed after the modules, in the order they are pulled.
+        * ------------------------------------------------------------------------ */
+        void pullArchiveMembers(Program& instructions){
+            vector<Archive*> archives;
+            vector< vector<char> > pulled;
+            unordered_set<string> defined;
+            vector<string> wanted;
+
+            for(string& name : this->libraries){
+                archives.push_back(new Archive(name));
+                pulled.push_back(vector<char>(archives.back()->memberCount(), 0));
+                if(!archives.back()->isOpen()){
+                    cerr << "File " << name << " could not be read. Ignoring this archive, this may produce unwanted results and errors." << endl;
+                }
+            }
+
+            if(this->verboseEnabled){
+                cout << left << "Archive members " << setw(14) << setfill('=') << '=' << endl;
+                cout << left << setw(15) << setfill(' ') << "Member";
+                cout << left << setw(15) << setfill(' ') << "Needed by" << endl;
+            }
+            this->collectNames(instructions, 0, defined, wanted);
+            // Names are looked up in the order they are first used
+            for(size_t next = 0; next < wanted.size(); next++){
+                string name = wanted[next];
+                if(defined.count(name) > 0){
+                    continue;
+                }
+                for(size_t a = 0; a < archives.size(); a++){
+                    uint32_t m = archives[a]->find(name);
+                    if(m == ARCHIVE_NO_MEMBER || pulled[a][m]){
+                        continue;
+                    }
+                    ObjectFile object(archives[a]->memberData(m), archives[a]->memberSize(m));
+                    Program module;
+                    int16_t sizeInBytes = 0;
+                    size_t first = instructions.count();
+
+                    pulled[a][m] = 1;
+                    this->loadModule(&object, module, sizeInBytes);
+                    instructions.append(module, this->programSizeInBytes / 2);
+                    this->programSizeInBytes += sizeInBytes;
+                    this->collectNames(instructions, first, defined, wanted);
+                    if(this->verboseEnabled){
+                        cout << left << setw(15) << setfill(' ') << archives[a]->memberName(m);
+                        cout << left << setw(15) << setfill(' ') << name << endl;
+                    }
+                    break;
+                }
+            }
+            if(this->verboseEnabled){
+                cout << left << setw(30) << setfill('=') << '=' << endl << endl;
+            }
+
+            for(Archive* a : archives){
+                delete a;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * void collectNames(Program& instructions, size_t first, unordered_set<string>& defined, vector<string>& used)
+        * Adds the names defined from the first instruction on to defined, and
+        * the names used as memory operands to used.
+        * ------------------------------------------------------------------------ */
+        void collectNames(Program& instructions, size_t first, unordered_set<string>& defined, vector<string>& used){
+            for(size_t k = first; k < instructions.count(); k++){
+                if(instructions.type[k] == InstructionType::LABEL){
+                    defined.insert(instructions.symbols.str(instructions.id[k]));
+                }else if(instructions.type[k] == InstructionType::VAR){
+                    defined.insert(instructions.symbols.str(instructions.textA[k]));
+                }else{
+                    if(instructions.refersToName(Program::kindOfA((OperandType)instructions.opType[k]), instructions.textA[k])){
+                        used.push_back(instructions.symbols.str(instructions.textA[k]));
+                    }
+                    if(instructions.refersToName(Program::kindOfB((OperandType)instructions.opType[k]), instructions.textB[k])){
+                        used.push_back(instructions.symbols.str(instructions.textB[k]));
+                    }
+                }
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool loadModule(ObjectFile* object, Program& module, int16_t& sizeInBytes)
+        * Receives a mapped module object file and reads its records into module,
+        * addressed from 0, leaving the module's size at sizeInBytes. The records
+        * are read in place, only their texts are interned. The module file must
+        * be produced by the Mounter provided in this project, it's output is
+        * formatted and accepted by this linker. Returns false if the file could
+        * not be opened.
         * ------------------------------------------------------------------------ */
-       void linkModule(string inputName){
-           ifstream* input = new ifstream(inputName.c_str(),ios::in|ios::binary);
-           
-           if(!input->is_open()){
-           		cerr << "File " << inputName << " could not be read. Ignoring this module, this may produce unwanted results and errors." << endl;
-           		return;
-           }
-
-           while(!input->eof()){
-                Instruction temp;
-                char fullText[128] = { 0 };
-                char id[128] = { 0 };
-                char opA[128] = { 0 };
-                char opB[128] = { 0 };
-                input->read((char *)fullText, sizeof(char)*128);
-                input->read((char *)id, sizeof(char)*128);
-                input->read((char *)opA, sizeof(char)*128);
-                input->read((char *)opB, sizeof(char)*128);
-                temp.fullText = string(fullText);
-                temp.id = string(id);
-                temp.opA = string(opA);
-                temp.opB = string(opB);
-                input->read((char *)(&temp.type), sizeof(InstructionType));
-                input->read((char *)(&temp.code), sizeof(InstructionCode));
-                input->read((char *)(&temp.opType), sizeof(OperandType));
-                input->read((char *)(&temp.address),sizeof(int16_t));
-                input->read((char *)(&temp.size), sizeof(int16_t));
-                temp.address = programSizeInBytes / 2;
+        bool loadModule(ObjectFile* object, Program& module, int16_t& sizeInBytes){
+            if(!object->isOpen()){
+                return false;
+            }
+
+            sizeInBytes = 0;
+            for(size_t k = 0; k < object->recordCount(); k++){
+                ObjectRecord temp = object->record(k);
+                temp.address = sizeInBytes / 2;
                 if(!temp.fullText.empty()){
-                	this->programSizeInBytes += this->bitSpaceToBytes(temp.size);
-                	this->program.push_back(temp);
-            	}
-            }    
-            input->close();
+                    sizeInBytes += this->bitSpaceToBytes(temp.size);
+                    module.append(temp);
+                }
+            }
+            return true;
         }
 
        /* ------------------------------------------------------------------------
-        * void resolveLabels(vector<Instruction>& instructions)
-        * The second pass, resolves all labels used in the program by searching
-        * the vector program for labels and dws, then for each one of those found
-        * search the vector again for instructions that used those, and replaces
-        * the operands refeering to them to the actual memory address they represent.
+        * bool resolveLabels(Program& instructions)
+        * The second pass, resolves all labels used in the program. Labels and dws
+        * are collected, in program order, into a table of names (the first
+        * definition of a name wins), then the instructions are patched in
+        * parallel, replacing the operands refeering to them by the actual memory
+        * address they represent, and decoded. Returns false, after reporting
+        * them in program order, if some names are not defined.
         * ------------------------------------------------------------------------ */
-        void resolveLabels(vector<Instruction>& instructions){
+        bool resolveLabels(Program& instructions){
+            vector<SymbolId> names; // From a name to the text of its address
+            vector<pair<size_t, string>> undefined; // By operand, 2 per instruction
+            mutex undefinedLock;
+
             if(this->verboseEnabled){
                 cout << left << "Table of names " << setw(15) << setfill('=') << '=' << endl;
                 cout << left << setw(15) << setfill(' ') << "Name";
-                cout << left << setw(15) << setfill(' ') << "Address" << endl;                
+                cout << left << setw(15) << setfill(' ') << "Address" << endl;
             }
 
             // Searches for labels and dws, passing by each instruction
-            for(Instruction& i : instructions){
-                if(i.type == InstructionType::LABEL || i.type == InstructionType::VAR){
-                    if(i.type == InstructionType::VAR){
+            for(size_t i = 0; i < instructions.count(); i++){
+                if(instructions.type[i] == InstructionType::LABEL || instructions.type[i] == InstructionType::VAR){
+                    if(instructions.type[i] == InstructionType::VAR){
                         // Variables are stored after the program. The program is stored at 0
-                        i.address = this->programSizeInBytes / 2;
-                        i.id = i.opA; // dw's pseudo instruction id is now it's name
+                        instructions.address[i] = this->programSizeInBytes / 2;
+                        instructions.id[i] = instructions.textA[i]; // dw's pseudo instruction id is now it's name
                         this->programSizeInBytes += 2;
                     }
-
-                    // Searches for instructions using current label or reserved word
-                    for(Instruction& j : instructions){
-                        // Replaces the labels and memory references by their actual address
-                        if(j.type == InstructionType::INSTRUCTION){
-                            if(j.opA == i.id){
-                                j.opA = to_string(i.address);
-                            }
-                            if(j.opB == i.id){
-                                j.opB = to_string(i.address);
-                            }
-                        }
+                    SymbolId name = instructions.id[i];
+                    SymbolId address = instructions.symbols.intern(to_string(instructions.address[i]));
+                    names.resize(instructions.symbols.size(), NO_SYMBOL);
+                    if(name != NO_SYMBOL && names[name] == NO_SYMBOL){
+                        names[name] = address;
                     }
 
                     if(this->verboseEnabled){
-                        cout << left << setw(15) << setfill(' ') << i.id;
-                        cout << left << setw(15) << setfill(' ') << i.address << endl;
+                        cout << left << setw(15) << setfill(' ') << instructions.symbols.str(instructions.id[i]);
+                        cout << left << setw(15) << setfill(' ') << instructions.address[i] << endl;
                     }
                 }
             }
+            names.resize(instructions.symbols.size(), NO_SYMBOL);
 
             if(this->verboseEnabled){
                 cout << left << setw(30) << setfill('=') << '=' << endl << endl;
             }
 
+            // Replaces the labels and memory references by their actual address
+            this->pool->parallelFor(instructions.count(), [&](size_t begin, size_t end){
+                for(size_t k = begin; k < end; k++){
+                    if(instructions.type[k] != InstructionType::INSTRUCTION){
+                        continue;
+                    }
+                    if(instructions.textA[k] != NO_SYMBOL && names[instructions.textA[k]] != NO_SYMBOL){
+                        instructions.textA[k] = names[instructions.textA[k]];
+                    }else if(instructions.refersToName(Program::kindOfA((OperandType)instructions.opType[k]), instructions.textA[k])){
+                        lock_guard<mutex> guard(undefinedLock);
+                        undefined.push_back(make_pair(2 * k, instructions.symbols.str(instructions.textA[k])));
+                    }
+                    if(instructions.textB[k] != NO_SYMBOL && names[instructions.textB[k]] != NO_SYMBOL){
+                        instructions.textB[k] = names[instructions.textB[k]];
+                    }else if(instructions.refersToName(Program::kindOfB((OperandType)instructions.opType[k]), instructions.textB[k])){
+                        lock_guard<mutex> guard(undefinedLock);
+                        undefined.push_back(make_pair(2 * k + 1, instructions.symbols.str(instructions.textB[k])));
+                    }
+                    instructions.decodeOperands(k);
+                }
+            });
+
+            // The chunks found them in any order
+            sort(undefined.begin(), undefined.end());
+            for(pair<size_t, string>& name : undefined){
+                cerr << "Name " << name.second << " is not defined." << endl;
+            }
+            return undefined.empty();
+        }
+
+       /* ------------------------------------------------------------------------
+        * void collectGarbage(Program& instructions)
+        * Removes what can't be reached from the entry point, the first
+        * instruction of the program. Starting there, follows the flow of the
+        * program: falls through to the next instruction unless it is a JMP,
+        * RET or HLT, and goes to the targets of jumps and CALLs. A name used as
+        * a memory operand by a reachable instruction keeps its dw, or, if it
+        * is a label, the code from there on. A dw used as the displacement of
+        * an indexed operand is the base of an array the index walks, so it
+        * keeps every dw stored after it too. Addresses are then computed again
+        * and what was removed is reported on cerr.
+        * ------------------------------------------------------------------------ */
+        void collectGarbage(Program& instructions){
+            vector<size_t> definition(instructions.symbols.size(), instructions.count());
+            vector<char> reachable(instructions.count(), 0);
+            vector<size_t> pending, kept;
+            size_t removedBytes = 0, removedVars = 0, removedInstructions = 0;
+            size_t firstIndexed = instructions.count(); // First dw used by an indexed operand
+
+            // Where each name is defined, the first definition wins
+            for(size_t k = 0; k < instructions.count(); k++){
+                SymbolId name = instructions.type[k] == InstructionType::VAR ? instructions.textA[k] : instructions.id[k];
+                if(instructions.type[k] != InstructionType::INSTRUCTION && name != NO_SYMBOL && definition[name] == instructions.count()){
+                    definition[name] = k;
+                }
+            }
+
+            // The entry point, dws are stored apart
+            size_t entry = 0;
+            while(entry < instructions.count() && instructions.type[entry] == InstructionType::VAR){
+                entry++;
+            }
+            pending.push_back(entry);
+            while(!pending.empty()){
+                size_t k = pending.back();
+                pending.pop_back();
+                if(k >= instructions.count() || reachable[k]){
+                    continue;
+                }
+                reachable[k] = 1;
+                if(instructions.type[k] == InstructionType::VAR){
+                    continue;
+                }
+
+                // Names used by the instruction, jump targets or data
+                if(instructions.type[k] == InstructionType::INSTRUCTION){
+                    OperandKind kinds[2] = { Program::kindOfA((OperandType)instructions.opType[k]), Program::kindOfB((OperandType)instructions.opType[k]) };
+                    SymbolId texts[2] = { instructions.textA[k], instructions.textB[k] };
+                    for(int o = 0; o < 2; o++){
+                        if(texts[o] == NO_SYMBOL || !instructions.refersToName(kinds[o], texts[o])){
+                            continue;
+                        }
+                        size_t used = definition[texts[o]];
+                        pending.push_back(used);
+                        if(kinds[o] == INDEXED_OPERAND && used < instructions.count()
+                           && instructions.type[used] == InstructionType::VAR && used < firstIndexed){
+                            firstIndexed = used;
+                        }
+                    }
+                    if(instructions.code[k] == InstructionCode::JUMP || instructions.code[k] == InstructionCode::RET || instructions.code[k] == InstructionCode::HALT){
+                        continue;
+                    }
+                }
+
+                // Falls through to the next instruction or label, dws are stored apart
+                size_t next = k + 1;
+                while(next < instructions.count() && instructions.type[next] == InstructionType::VAR){
+                    next++;
+                }
+                pending.push_back(next);
+            }
+            for(size_t k = firstIndexed; k < instructions.count(); k++){
+                if(instructions.type[k] == InstructionType::VAR){
+                    reachable[k] = 1;
+                }
+            }
+
+            cerr << left << "Removed by --gc " << setw(14) << setfill('=') << '=' << endl;
+            cerr << left << setw(15) << setfill(' ') << "Address";
+            cerr << left << setw(15) << setfill(' ') << "Command" << endl;
+            for(size_t k = 0; k < instructions.count(); k++){
+                if(reachable[k]){
+                    kept.push_back(k);
+                    continue;
+                }
+                if(instructions.type[k] == InstructionType::VAR){
+                    cerr << left << setw(15) << setfill(' ') << "dw";
+                    cerr << left << setw(15) << setfill(' ') << instructions.symbols.str(instructions.textA[k]) << endl;
+                    removedVars++;
+                }else if(instructions.type[k] == InstructionType::INSTRUCTION){
+                    cerr << left << setw(15) << setfill(' ') << instructions.address[k];
+                    cerr << left << setw(15) << setfill(' ') << instructions.debugInstruction(k) << endl;
+                    removedBytes += this->bitSpaceToBytes(instructions.size[k]);
+                    removedInstructions++;
+                }
+            }
+            cerr << removedInstructions << " instructions (" << removedBytes << " bytes) and " << removedVars << " dws removed." << endl;
+            cerr << left << setw(30) << setfill('=') << '=' << endl << endl;
+
+            // Addresses of what is left
+            this->keepEntries(instructions, kept);
+            this->assignAddresses(instructions);
+        }
+
+       /* ------------------------------------------------------------------------
+        * void assignAddresses(Program& instructions)
+        * Computes again the address of every instruction and label, and the
+        * size of the program, after instructions were removed or added.
+        * ------------------------------------------------------------------------ */
+        void assignAddresses(Program& instructions){
+            this->programSizeInBytes = 0;
+            for(size_t k = 0; k < instructions.count(); k++){
+                instructions.address[k] = this->programSizeInBytes / 2;
+                this->programSizeInBytes += this->bitSpaceToBytes(instructions.size[k]);
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * void inlineLeafRoutines(Program& instructions)
+        * Replaces CALLs to small leaf routines by the routine's body. A leaf
+        * routine starts at a label and is a straight run of instructions ending
+        * in its only RET: no CALL, no jump, no PUSH or POP, which could play
+        * with the return address, no HLT and no label inside. Its body, without
+        * the RET, must be at most inlineBudget bytes. The routines themselves
+        * are kept, --gc drops the ones no longer called. With a profile, calls
+        * that never ran are left alone. Prints the size each routine added or
+        * saved.
+        * ------------------------------------------------------------------------ */
+        void inlineLeafRoutines(Program& instructions){
+            vector<size_t> definition(instructions.symbols.size(), instructions.count());
+            vector<size_t> bodyEnd(instructions.count(), 0); // Label to its RET, 0 if not a leaf
+            vector<size_t> sites(instructions.count(), 0); // Calls inlined, per routine
+            vector<size_t> entries;
+            vector<uint64_t> heat; // Times each entry ran, a copied body runs as often as its call
+
+            for(size_t k = 0; k < instructions.count(); k++){
+                if(instructions.type[k] == InstructionType::LABEL && definition[instructions.id[k]] == instructions.count()){
+                    definition[instructions.id[k]] = k;
+                }
+            }
+
+            // Finds the leaf routines that fit the budget
+            for(size_t k = 0; k < instructions.count(); k++){
+                if(instructions.type[k] != InstructionType::LABEL){
+                    continue;
+                }
+                size_t n = k + 1, bytes = 0;
+                while(n < instructions.count() && instructions.type[n] == InstructionType::LABEL){
+                    n++;
+                }
+                for(; n < instructions.count() && instructions.type[n] == InstructionType::INSTRUCTION; n++){
+                    InstructionCode code = (InstructionCode)instructions.code[n];
+                    if(code == InstructionCode::RET){
+                        break;
+                    }
+                    if(code == InstructionCode::CALL || code == InstructionCode::JUMP || code == InstructionCode::JZ || code == InstructionCode::JS
+                       || code == InstructionCode::PUSH || code == InstructionCode::POP || code == InstructionCode::HALT){
+                        n = instructions.count();
+                        break;
+                    }
+                    bytes += this->bitSpaceToBytes(instructions.size[n]);
+                }
+                if(n < instructions.count() && instructions.code[n] == InstructionCode::RET
+                   && instructions.type[n] == InstructionType::INSTRUCTION && bytes <= this->inlineBudget){
+                    bodyEnd[k] = n;
+                }
+            }
+
+            // Copies the bodies over the calls
+            for(size_t k = 0; k < instructions.count(); k++){
+                size_t routine = instructions.textA[k] == NO_SYMBOL ? instructions.count() : definition[instructions.textA[k]];
+                if(instructions.type[k] != InstructionType::INSTRUCTION || instructions.code[k] != InstructionCode::CALL
+                   || routine == instructions.count() || bodyEnd[routine] == 0 || this->isCold(k)){
+                    entries.push_back(k);
+                    heat.push_back(this->executions.empty() ? 0 : this->executions[k]);
+                    continue;
+                }
+                for(size_t n = routine; n < bodyEnd[routine]; n++){
+                    if(instructions.type[n] == InstructionType::INSTRUCTION){
+                        entries.push_back(n);
+                        heat.push_back(this->executions.empty() ? 0 : this->executions[k]);
+                    }
+                }
+                sites[routine]++;
+            }
+
+            cerr << left << "Inlined routines " << setw(13) << setfill('=') << '=' << endl;
+            cerr << left << setw(15) << setfill(' ') << "Name";
+            cerr << left << setw(10) << setfill(' ') << "Body";
+            cerr << left << setw(10) << setfill(' ') << "Calls";
+            cerr << left << setw(10) << setfill(' ') << "Size (bytes)" << endl;
+            long total = 0;
+            for(size_t k = 0; k < instructions.count(); k++){
+                if(sites[k] == 0){
+                    continue;
+                }
+                long body = 0;
+                for(size_t n = k; n < bodyEnd[k]; n++){
+                    body += this->bitSpaceToBytes(instructions.size[n]);
+                }
+                // Each call of 4 bytes becomes the body
+                long delta = (long)sites[k] * (body - 4);
+                total += delta;
+                cerr << left << setw(15) << setfill(' ') << instructions.symbols.str(instructions.id[k]);
+                cerr << left << setw(10) << setfill(' ') << body;
+                cerr << left << setw(10) << setfill(' ') << sites[k];
+                cerr << left << setw(10) << setfill(' ') << showpos << delta << noshowpos << endl;
+            }
+            cerr << "Code size changed by " << showpos << total << noshowpos << " bytes, calls and returns avoided on every inlined call." << endl;
+            cerr << left << setw(30) << setfill('=') << '=' << endl << endl;
+
+            instructions.select(entries);
+            if(!this->executions.empty()){
+                this->executions.swap(heat);
+            }
+            this->assignAddresses(instructions);
+        }
+
+       /* ------------------------------------------------------------------------
+        * void keepEntries(Program& instructions, const vector<size_t>& entries)
+        * Keeps only the listed instructions, and what the profile says of them.
+        * ------------------------------------------------------------------------ */
+        void keepEntries(Program& instructions, const vector<size_t>& entries){
+            instructions.select(entries);
+            if(!this->executions.empty()){
+                Program::pick(this->executions, entries);
+            }
+        }
+
+        // True if there is a profile and the k-th instruction never ran in it
+        bool isCold(size_t k){
+            return !this->executions.empty() && this->executions[k] == 0;
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool loadProfile(Program& instructions)
+        * Reads the --profile-use file, written by the emulator running the same
+        * modules linked without --gc, --inline or --profile-use, so addresses
+        * in the profile are the ones just read. Returns false, leaving no
+        * profile, if the file can't be read or doesn't match the program.
+        * ------------------------------------------------------------------------ */
+        bool loadProfile(Program& instructions){
+            Profile profile;
+            uint64_t matched = 0;
+
+            if(!profile.read(this->profileName)){
+                cerr << "Profile " << this->profileName << " could not be read, linking without it." << endl;
+                return false;
+            }
+            this->executions.assign(instructions.count(), 0);
+            for(size_t k = 0; k < instructions.count(); k++){
+                if(instructions.type[k] == InstructionType::INSTRUCTION){
+                    this->executions[k] = profile.executionsAt(instructions.address[k]);
+                    matched += this->executions[k];
+                }
+            }
+            // Every run counted must be of an instruction of this program
+            if(matched != profile.totalExecutions()){
+                cerr << "Profile " << this->profileName << " was taken from another program, linking without it." << endl;
+                this->executions.clear();
+                return false;
+            }
+            return true;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void layoutHotPaths(Program& instructions)
+        * Moves blocks so that hot jumps become fallthrough. A block starts at
+        * the labels a JMP goes to and runs until its own JMP, RET or HLT. If
+        * nothing falls into it, because the instruction before it is a JMP,
+        * RET or HLT, it can be moved right after a JMP to it, and the JMP
+        * dropped. Jumps that ran most often are handled first, jumps that never
+        * ran are left alone. Simple86 has no inverse of JZ and JS, so
+        * conditional branches keep their direction.
+        * ------------------------------------------------------------------------ */
+        void layoutHotPaths(Program& instructions){
+            size_t moved = 0;
+            uint64_t avoided = 0;
+
+            cerr << left << "Profile guided layout " << setw(8) << setfill('=') << '=' << endl;
+            cerr << left << setw(15) << setfill(' ') << "Block";
+            cerr << left << setw(15) << setfill(' ') << "Jumps avoided" << endl;
+            while(true){
+                vector<size_t> definition(instructions.symbols.size(), instructions.count());
+                size_t best = instructions.count(), start = 0, end = 0;
+
+                for(size_t k = 0; k < instructions.count(); k++){
+                    if(instructions.type[k] == InstructionType::LABEL && definition[instructions.id[k]] == instructions.count()){
+                        definition[instructions.id[k]] = k;
+                    }
+                }
+
+                // The hottest JMP whose target block can be moved
+                for(size_t k = 0; k < instructions.count(); k++){
+                    if(instructions.type[k] != InstructionType::INSTRUCTION || instructions.code[k] != InstructionCode::JUMP || this->isCold(k)
+                       || instructions.textA[k] == NO_SYMBOL || definition[instructions.textA[k]] == instructions.count()
+                       || (best < instructions.count() && this->executions[best] >= this->executions[k])){
+                        continue;
+                    }
+                    size_t s = definition[instructions.textA[k]], e, before;
+                    while(s > 0 && instructions.type[s - 1] != InstructionType::INSTRUCTION){
+                        s--;
+                    }
+                    for(before = s; before > 0 && instructions.type[before - 1] == InstructionType::VAR; before--);
+                    if(before == 0 || !this->endsBlock(instructions, before - 1)){
+                        continue;
+                    }
+                    for(e = s; e < instructions.count() && !(instructions.type[e] == InstructionType::INSTRUCTION && this->endsBlock(instructions, e)); e++);
+                    if(e == instructions.count() || (k >= s && k <= e)){
+                        continue;
+                    }
+                    best = k;
+                    start = s;
+                    end = e;
+                }
+                if(best == instructions.count()){
+                    break;
+                }
+
+                // The block takes the place of the JMP
+                vector<size_t> entries;
+                for(size_t k = 0; k < instructions.count(); k++){
+                    if(k == best){
+                        for(size_t n = start; n <= end; n++){
+                            entries.push_back(n);
+                        }
+                    }else if(k < start || k > end){
+                        entries.push_back(k);
+                    }
+                }
+                cerr << left << setw(15) << setfill(' ') << instructions.symbols.str(instructions.textA[best]);
+                cerr << left << setw(15) << setfill(' ') << this->executions[best] << endl;
+                moved++;
+                avoided += this->executions[best];
+                this->keepEntries(instructions, entries);
+            }
+            cerr << moved << " blocks moved, " << moved * 4 << " bytes and " << avoided << " jumps saved per run." << endl;
+            cerr << left << setw(30) << setfill('=') << '=' << endl << endl;
+            this->assignAddresses(instructions);
+        }
 
+        // True if the k-th instruction never falls through to the next one
+        bool endsBlock(Program& instructions, size_t k){
+            return instructions.type[k] == InstructionType::INSTRUCTION && (instructions.code[k] == InstructionCode::JUMP
+                   || instructions.code[k] == InstructionCode::RET || instructions.code[k] == InstructionCode::HALT);
         }
-       
+
        /* ------------------------------------------------------------------------
         * int link()
         * Reads modules object files. Resolve addresses and writes an executable
-        * binary to the output file.
+        * binary to the output file. Returns 0, having written nothing, if some
+        * names are not defined, 1 otherwise.
         * ------------------------------------------------------------------------ */
         int link(){
+            // Verbose output shows every instruction, --gc, --inline,
+            // --profile-use and archives look at all of them, so they need
+            // the full program
+            if(this->cache != nullptr && !this->verboseEnabled && !this->gcEnabled && this->inlineBudget == 0
+               && this->profileName.empty() && this->libraries.empty()){
+                return this->linkIncremental();
+            }
+
             this->readProgram(this->inputs); // First step
-            this->resolveLabels(this->program); // Second step
-            
-            //Writes the end results inside the vector<Instruction> program
+            if(!this->libraries.empty()){
+                this->pullArchiveMembers(this->program);
+            }
+            if(!this->profileName.empty()){
+                this->loadProfile(this->program);
+            }
+            if(this->inlineBudget > 0){
+                this->inlineLeafRoutines(this->program);
+            }
+            if(!this->executions.empty()){
+                this->layoutHotPaths(this->program);
+            }
+            if(this->gcEnabled){
+                this->collectGarbage(this->program);
+            }
+            if(!this->resolveLabels(this->program)){ // Second step
+                return 0;
+            }
+
+            //Writes the end results inside the Program program
             if(this->verboseEnabled){
                 this->writeTextOutput(this->program);
             }
 
-            // Transforms the vector<Instruction> program into a real program output
+            // Transforms the Program program into a real program output
             // to the output file.
             this->writeBin(this->program);
-            output->close();
+            this->output->flush();
+            return 1;
+        }
+
+       /* ------------------------------------------------------------------------
+        * int linkIncremental()
+        * Same as link(), but each module is taken as a ModuleLayout from the
+        * build cache, keyed by the module's bytes. Only modules that changed are
+        * read and encoded again, the others are just placed and patched.
+        * Returns 0, as link() does, if some names are not defined.
+        * ------------------------------------------------------------------------ */
+        int linkIncremental(){
+            vector<ModuleLayout> layouts(this->inputs.size());
+            vector<int16_t> bases(this->inputs.size(), 0);
+            vector<string> codes(this->inputs.size());
+            vector<char> loaded(this->inputs.size(), 0);
+            unordered_map<string, int16_t> addresses;
+            int16_t varAddress;
+
+            this->pool->parallelFor(this->inputs.size(), [&](size_t begin, size_t end){
+                for(size_t m = begin; m < end; m++){
+                    loaded[m] = this->loadLayout(this->inputs[m], layouts[m]);
+                }
+            });
+
+            // Places the modules, then the dws after the program, in program order
+            for(size_t m = 0; m < layouts.size(); m++){
+                if(!loaded[m]){
+                    cerr << "File " << this->inputs[m] << " could not be read. Ignoring this module, this may produce unwanted results and errors." << endl;
+                }
+                bases[m] = this->programSizeInBytes;
+                this->programSizeInBytes += layouts[m].sizeInBytes;
+            }
+            varAddress = this->programSizeInBytes / 2;
+            for(size_t m = 0; m < layouts.size(); m++){
+                for(Definition& d : layouts[m].definitions){
+                    if(d.type == InstructionType::VAR){
+                        addresses.insert(make_pair(d.name, varAddress++));
+                    }else{
+                        addresses.insert(make_pair(d.name, bases[m] / 2 + d.address));
+                    }
+                }
+            }
+
+            // Patches every module's code with the addresses of the names it uses
+            bool defined = true;
+            for(size_t m = 0; m < layouts.size(); m++){
+                for(Relocation& r : layouts[m].relocations){
+                    if(addresses.find(r.name) == addresses.end()){
+                        cerr << "Name " << r.name << " used by " << this->inputs[m] << " is not defined." << endl;
+                        defined = false;
+                    }
+                }
+            }
+            if(!defined){
+                return 0;
+            }
+            this->pool->parallelFor(layouts.size(), [&](size_t begin, size_t end){
+                for(size_t m = begin; m < end; m++){
+                    codes[m] = layouts[m].code;
+                    for(Relocation& r : layouts[m].relocations){
+                        int16_t address = addresses.find(r.name)->second;
+                        if(r.kind == WORD_ADDRESS){
+                            codes[m][r.offset] = (char)address;
+                            codes[m][r.offset + 1] = (char)(address >> 8);
+                        }else{
+                            codes[m][r.offset] = (char)(std::stoul(to_string(address), nullptr, 16) >> 8);
+                        }
+                    }
+                }
+            });
+
+            this->output->put(0);
+            this->output->put(0);
+            for(string& c : codes){
+                this->output->write(c.data(), c.size());
+            }
+            this->writePredecoded(codes);
+            this->output->flush();
+            this->cache->writeStatistics(cerr);
             return 1;
         }
 
        /* ------------------------------------------------------------------------
-        * void writeTextOutput(vector<Instruction> program)
-        * Outputs all the Instructions inside the vector. Used after the second pass
-        * to show what has been understood by the mounter, and to what the labels
-        * were resolved to.
+        * bool loadLayout(string inputName, ModuleLayout& layout)
+        * Finds the layout of a module in the build cache, or builds and stores
+        * it. Returns false if the module could not be read.
         * ------------------------------------------------------------------------ */
-        void writeTextOutput(vector<Instruction> program){
+        bool loadLayout(string inputName, ModuleLayout& layout){
+            ObjectFile* object = this->openModule(inputName);
+            Program module;
+            string key, stored;
+
+            if(!object->isOpen()){
+                delete object;
+                return false;
+            }
+            key = this->cache->keyFor("linker", object->bytes(), object->size());
+            if(this->cache->load(key, stored) && layout.deserialize(stored)){
+                delete object;
+                return true;
+            }
+
+            layout = ModuleLayout();
+            this->loadModule(object, module, layout.sizeInBytes);
+            delete object;
+            for(size_t i = 0; i < module.count(); i++){
+                if(module.type[i] == InstructionType::LABEL){
+                    layout.definitions.push_back(Definition{InstructionType::LABEL, module.address[i], module.symbols.str(module.id[i])});
+                }else if(module.type[i] == InstructionType::VAR){
+                    layout.definitions.push_back(Definition{InstructionType::VAR, 0, module.symbols.str(module.textA[i])});
+                }else{
+                    module.decodeOperands(i);
+                    this->encodeInstruction(module, i, layout.code, &layout.relocations);
+                }
+            }
+            this->cache->store(key, layout.serialize());
+            return true;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void writeTextOutput(Program& program)
+        * Outputs all the instructions inside the program. Used after the second
+        * pass to show what has been understood by the mounter, and to what the
+        * labels were resolved to.
+        * ------------------------------------------------------------------------ */
+        void writeTextOutput(Program& program){
             // Everything output as table
             cout << "The following program will be written in binary:" << endl;
             cout << left << setw(15) << setfill(' ') << "Address";
             cout << left << setw(30) << setfill(' ') << "Command";
             cout << left << setw(10) << setfill(' ') << "Size (bytes)" << endl;
-            for(Instruction& ins : program){
+            for(size_t ins = 0; ins < program.count(); ins++){
                 // VAR and LABEL have 0 bits as size, and won't be output to binary, only
                 // the addresses those resolve to.
-                if(ins.type != InstructionType::VAR && ins.type != InstructionType::LABEL){
-                    cout << left << setw(15) << setfill(' ') << ins.address;
-                    cout << left << setw(30) << setfill(' ') << ins.debugInstruction();
-                    cout << left << setw(10) << setfill(' ') << this->bitSpaceToBytes(ins.size) << endl;
+                if(program.type[ins] != InstructionType::VAR && program.type[ins] != InstructionType::LABEL){
+                    cout << left << setw(15) << setfill(' ') << program.address[ins];
+                    cout << left << setw(30) << setfill(' ') << program.debugInstruction(ins);
+                    cout << left << setw(10) << setfill(' ') << this->bitSpaceToBytes(program.size[ins]) << endl;
                 }
             }
         }
@@ -203,70 +881,168 @@ class Linker{
         }
 
        /* ------------------------------------------------------------------------
-        * void writeBin(vector<Instruction> toWrite)
-        * Transforms the vector into a binary program output to the output file.
-        * The vector is intact. This is the second compilation pass.
+        * void writeBin(Program& toWrite)
+        * Transforms the program into a binary program output to the output file.
+        * The program is intact. This is the second compilation pass.
         * Uses little endian notation, as required by the Simple86 machine.
+        * Each worker encodes a contiguous slice of the program into its own
+        * buffer, the buffers are then written in program order.
         * ------------------------------------------------------------------------ */
-        void writeBin(vector<Instruction> toWrite){
-            
+        void writeBin(Program& toWrite){
+            size_t slices = this->pool->size();
+            vector<string> buffers(slices);
+
+            this->pool->parallelFor(slices, [&](size_t first, size_t last){
+                for(size_t s = first; s < last; s++){
+                    size_t begin = toWrite.count() * s / slices;
+                    size_t end = toWrite.count() * (s + 1) / slices;
+                    for(size_t k = begin; k < end; k++){
+                        this->encodeInstruction(toWrite, k, buffers[s]);
+                    }
+                }
+            });
+
             // The word representing the address where the first instruction of
             // the program is at.
             this->output->put(0);
             this->output->put(0);
-            // for each instruction inside the vector
-            for(Instruction& i : toWrite){
-                if(i.type == INSTRUCTION){
-                    // The ofstream->put(char) function writes in binary
-                    this->output->put((char)i.opType); // Operand type
-                    this->output->put((char)i.code); // Instruction code
-                    
-                    // Outputs opA according to the operand type
-                    if(i.opType==OperandType::R || i.opType==OperandType::RR || i.opType==OperandType::RM || i.opType==OperandType::RI){
-                        this->output->put((char)i.getRegisterCode(i.opA));
-                        this->output->put(0);
-                    } else if(i.opType==OperandType::I){
-                        // Converts the string representing a hexa number to binary
-                        this->output->put((char)std::stoul(i.opA, nullptr, 16));
-                        this->output->put((char)(std::stoul(i.opA, nullptr, 16) >> 8));
-                    } else if(i.opType==OperandType::M || i.opType==OperandType::MI || i.opType==OperandType::MR){
-                        // Converts the string representing a int number to binary
-                        this->output->put((char)stoi(i.opA));
-                        this->output->put((char)(stoi(i.opA) >> 8));
-                    }
-                    
-                    // Outputs opB according to the operand type
-                    if(i.opType==OperandType::RR || i.opType==OperandType::MR){
-                        this->output->put((char)i.getRegisterCode(i.opB));
-                        this->output->put(0);
-                    } else if(i.opType==OperandType::MI || i.opType==OperandType::RI){
-                        // Converts the string representing a hexa number to binary
-                        this->output->put((char)std::stoul(i.opB, nullptr, 16));
-                        this->output->put((char)(std::stoul(i.opA, nullptr, 16) >> 8));                        
-                    }
-                    else if(i.opType==OperandType::RM){
-                        // Converts the string representing a int number to binary
-                        this->output->put((char)stoi(i.opB));
-                        this->output->put((char)(stoi(i.opB) >> 8));
+            for(string& b : buffers){
+                this->output->write(b.data(), b.size());
+            }
+            this->writePredecoded(buffers);
+        }
+
+       /* ------------------------------------------------------------------------
+        * void writePredecoded(vector<string>& pieces)
+        * With --predecode, appends the predecoded section of the code just
+        * written, given in pieces, aligned to 8 bytes.
+        * ------------------------------------------------------------------------ */
+        void writePredecoded(vector<string>& pieces){
+            string code;
+
+            if(!this->predecodeEnabled){
+                return;
+            }
+            for(string& p : pieces){
+                code += p;
+            }
+            uint64_t sectionAt = 2 + code.size();
+            while(sectionAt % 8 != 0){
+                this->output->put(0);
+                sectionAt++;
+            }
+            string section = PredecodedImage::build(code, sectionAt);
+            this->output->write(section.data(), section.size());
+        }
+
+       /* ------------------------------------------------------------------------
+        * void encodeInstruction(Program& p, size_t i, string& out, vector<Relocation>* relocations)
+        * Appends the binary form of the i-th instruction, already decoded, to out.
+        * Labels and dws produce nothing. With relocations, the instruction is not
+        * resolved yet: memory operands, which are always names, are written as 0
+        * and recorded as relocations, to be patched when the module is placed.
+        * ------------------------------------------------------------------------ */
+        void encodeInstruction(Program& p, size_t i, string& out, vector<Relocation>* relocations = nullptr){
+            OperandType opType = (OperandType)p.opType[i];
+
+            if(p.type[i] != INSTRUCTION){
+                return;
+            }
+            out.push_back((char)opType); // Operand type
+            out.push_back((char)p.code[i]); // Instruction code
+
+            // Outputs opA according to the operand type
+            switch(Program::kindOfA(opType)){
+                case REGISTER_OPERAND:
+                case IMMEDIATE_OPERAND:
+                    out.push_back((char)p.opA[i]);
+                    out.push_back((char)(p.opA[i] >> 8));
+                    break;
+                case MEMORY_OPERAND:
+                    this->encodeAddress(p, p.textA[i], p.opA[i], out, relocations);
+                    break;
+                case INDEXED_OPERAND:
+                    this->encodeDisplacement(p, p.textA[i], p.opA[i], out, relocations);
+                    break;
+                default:
+                    break;
+            }
+
+            // Outputs opB according to the operand type
+            switch(Program::kindOfB(opType)){
+                case REGISTER_OPERAND:
+                    out.push_back((char)p.opB[i]);
+                    out.push_back((char)(p.opB[i] >> 8));
+                    break;
+                case IMMEDIATE_OPERAND:
+                    out.push_back((char)p.opB[i]);
+                    // The high byte is taken from the text of opA read as a hexa
+                    // number, for MI it is a name until the module is placed.
+                    // Indexed stores take the whole immediate.
+                    if(opType == OperandType::XI){
+                        out.push_back((char)(p.opB[i] >> 8));
+                    }else if(relocations != nullptr && opType==OperandType::MI){
+                        relocations->push_back(Relocation{(uint32_t)out.size(), HEX_HIGH_BYTE, p.symbols.str(p.textA[i])});
+                        out.push_back(0);
+                    }else{
+                        out.push_back((char)(std::stoul(p.symbols.str(p.textA[i]), nullptr, 16) >> 8));
                     }
-                }
+                    break;
+                case MEMORY_OPERAND:
+                    this->encodeAddress(p, p.textB[i], p.opB[i], out, relocations);
+                    break;
+                case INDEXED_OPERAND:
+                    this->encodeDisplacement(p, p.textB[i], p.opB[i], out, relocations);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * void encodeAddress(Program& p, SymbolId name, int16_t address, string& out, vector<Relocation>* relocations)
+        * Appends a memory operand, or, with relocations, records the name it
+        * refers to.
+        * ------------------------------------------------------------------------ */
+        void encodeAddress(Program& p, SymbolId name, int16_t address, string& out, vector<Relocation>* relocations){
+            if(relocations != nullptr){
+                relocations->push_back(Relocation{(uint32_t)out.size(), WORD_ADDRESS, p.symbols.str(name)});
+                out.push_back(0);
+                out.push_back(0);
+            }else{
+                out.push_back((char)address);
+                out.push_back((char)(address >> 8));
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * void encodeDisplacement(Program& p, SymbolId text, int16_t displacement, string& out, vector<Relocation>* relocations)
+        * Appends the displacement of an indexed operand, an address when it is
+        * a name, relocated as memory operands are.
+        * ------------------------------------------------------------------------ */
+        void encodeDisplacement(Program& p, SymbolId text, int16_t displacement, string& out, vector<Relocation>* relocations){
+            if(Program::isName(p.symbols.str(text))){
+                this->encodeAddress(p, text, displacement, out, relocations);
+            }else{
+                out.push_back((char)displacement);
+                out.push_back((char)(displacement >> 8));
             }
         }
 
         /* ------------------------------------------------------------------------
-        * void debugReceivedInstruction(Instruction& i)
-        * Prints (formatted) a Instruction and what is inside it so far.
+        * void debugReceivedInstruction(size_t i)
+        * Prints (formatted) the i-th instruction and what is inside it so far.
         * Used at the first step if verbose is enabled.
         * ------------------------------------------------------------------------ */
-        void debugReceivedInstruction(Instruction& i){
-            string ops = i.id;
-            if(!i.opA.empty()){
-                ops += " " + i.opA;
+        void debugReceivedInstruction(size_t i){
+            string ops = this->program.symbols.str(this->program.id[i]);
+            if(!this->program.symbols.empty(this->program.textA[i])){
+                ops += " " + this->program.operandText(this->program.textA[i], Program::kindOfA((OperandType)this->program.opType[i]));
             }
-            if(!i.opB.empty()){
-                ops += ", " + i.opB;
+            if(!this->program.symbols.empty(this->program.textB[i])){
+                ops += ", " + this->program.operandText(this->program.textB[i], Program::kindOfB((OperandType)this->program.opType[i]));
             }
-            cout << left << setw(15) << setfill(' ') << i.address;
+            cout << left << setw(15) << setfill(' ') << this->program.address[i];
             cout << left << setw(10) << setfill(' ') << ops;
             cout << endl;
         }
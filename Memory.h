@@ -3,14 +3,60 @@
 * Memory module for a Simple86 machine, implemented
 * according to the specifications.
 *
+* A memory holds MEMORY_LIMIT words unless told otherwise, and up
+* to MEMORY_MAX_WORDS, the whole of the 16 bits address space.
+* Addresses are the register's 16 bits read as unsigned. The size only
+* places the stack and the device: any address, past the size too, is
+* a word of the whole 16 bits address space, allocated as any other.
+*
+* The words are kept in pages of MEMORY_PAGE_WORDS words, allocated
+* on the first write to them: until then a page is the zero page,
+* shared by every memory. A copy of a memory shares its pages with
+* it, copy-on-write, so machines loaded from the same program share
+* its code image until they write over it. A memory must not run
+* while it is copied. The page table always covers the whole address
+* space, MEMORY_PAGES entries, so that any address reaches a page. A
+* memory that only holds its program costs its page table and its
+* pages of code, shared with its copies.
+*
+* In SMP mode several harts, each a Memory of its own with its own
+* registers, share the words of one of them. Their memory model:
+* a plain access (MOV, ADD, ... to or from memory) reads or writes
+* the whole word at once, never torn, but may be seen by the other
+* harts in any order; XCHG and CAS are atomic, and sequentially
+* consistent among themselves and with FENCE; FENCE keeps every
+* access before it ordered before every access after it. MOVS and
+* STOS are a plain access to each word of their blocks.
+*
+* An output device can be mapped at the top of the memory: a block of
+* words the program fills with plain MOVs, and, as the last word, a
+* doorbell. Writing n to the doorbell writes the first n words of the
+* block to the device's Console in one go. Only plain writes ring it,
+* not XCHG, CAS, MOVS or STOS.
+*
 */
 #ifndef SIMULA_MEMORY
 #define SIMULA_MEMORY 1
 
 #include<cstdint>
+#include<cstring>
+#include<algorithm>
+#include<vector>
+#include"Console.h"
 #define LOW_MASK  0b0000000011111111
 #define HIGH_MASK 0b1111111100000000
-#define MEMORY_LIMIT 1000
+#define MEMORY_LIMIT 1000 // Words of a memory, as the specification says
+#define MEMORY_MAX_WORDS 65536
+#define MEMORY_PAGE_SHIFT 11
+#define MEMORY_PAGE_WORDS (1 << MEMORY_PAGE_SHIFT) // 4 KiB, as the host's pages
+#define MEMORY_PAGE_MASK (MEMORY_PAGE_WORDS - 1)
+#define MEMORY_PAGES (MEMORY_MAX_WORDS >> MEMORY_PAGE_SHIFT)
+
+// A page of words, shared by the memories counted in references.
+struct MemoryPage {
+    int32_t references;
+    int16_t words[MEMORY_PAGE_WORDS];
+};
 
 // Memory module for Simple86
 class Memory {
@@ -26,18 +72,194 @@ private:
     int16_t regIP;
     int16_t regZF;
     int16_t regSF;
-    int16_t MEM[MEMORY_LIMIT];
+    int32_t size; // Words of the memory
+    MemoryPage** pages; // The page table, see above
+    bool ownsPages; // False if the table is the one of the hart shared with
+    bool halted; // Set by HLT, IP can't always be past the memory
+    // The hart's number and how many there are, 0 and 1 outside SMP mode.
+    int16_t hartId;
+    int16_t hartCount;
+    // Words holding the program's code, and whether any was written since.
+    int32_t codeLimit;
+    bool codeModified;
+    // The output device, if mapped: its words start at outputAt, and its
+    // doorbell, size if there is no device, follows them.
+    Console* outputDevice;
+    int32_t outputAt;
+    int32_t doorbell;
+
+    // The page every memory starts with, all zeros. Its references never
+    // fall to 1, so it is never written, and never freed.
+    static MemoryPage* zeroPage() {
+        static MemoryPage zero = { 2, { 0 } };
+        return &zero;
+    }
+
+    // Counts one more memory sharing page, and returns it.
+    static MemoryPage* sharePage(MemoryPage* page) {
+        if (page != Memory::zeroPage()) {
+            __atomic_add_fetch(&page->references, 1, __ATOMIC_RELAXED);
+        }
+        return page;
+    }
+
+    // Counts one memory less sharing page, freeing it if it was the last one.
+    static void releasePage(MemoryPage* page) {
+        if (page != Memory::zeroPage() && __atomic_sub_fetch(&page->references, 1, __ATOMIC_ACQ_REL) == 0) {
+            delete page;
+        }
+    }
+
+    // Releases the pages and the page table, if they are this memory's.
+    void releasePages() {
+        if (!this->ownsPages) {
+            return;
+        }
+        for (int32_t i = 0; i < MEMORY_PAGES; i++) {
+            Memory::releasePage(this->pages[i]);
+        }
+        delete[] this->pages;
+        this->pages = nullptr;
+    }
+
+    /* ------------------------------------------------------------------------
+    * MemoryPage* writablePage(int32_t index)
+    * Returns the index-th page, first copying it into a page of this memory
+    * alone if it is shared, with other memories or as the zero page.
+    * ------------------------------------------------------------------------ */
+    MemoryPage* writablePage(int32_t index) {
+        MemoryPage* page = this->pages[index];
+
+        if (__atomic_load_n(&page->references, __ATOMIC_ACQUIRE) != 1) {
+            MemoryPage* copy = new MemoryPage;
+            copy->references = 1;
+            memcpy(copy->words, page->words, sizeof(copy->words));
+            this->pages[index] = copy;
+            Memory::releasePage(page);
+            page = copy;
+        }
+        return page;
+    }
+
+    // Returns the word at address, to be written.
+    int16_t* writableWord(uint16_t address) {
+        return &this->writablePage(address >> MEMORY_PAGE_SHIFT)->words[address & MEMORY_PAGE_MASK];
+    }
+
+    // Returns the word at address, to be read.
+    int16_t* word(uint16_t address) {
+        return &this->pages[address >> MEMORY_PAGE_SHIFT]->words[address & MEMORY_PAGE_MASK];
+    }
 
 public:
     // Keywords to access each one of the machine's registers.
     // Pass those to the public methods controlling the registers access.
     enum Register { AX, AL, AH, BX, BL, BH, CX, CL, CH, BP, SP, IP, ZF, SF };
 
-    // Initializes a Memory object, with the initial state specified in the Simple86 description.
-    Memory() {
-        this->regBP = MEMORY_LIMIT;
-        this->regSP = MEMORY_LIMIT;
+    // Initializes a Memory object of size words, with the initial state specified
+    // in the Simple86 description: the registers are 0 but for the stack, that
+    // starts at the end of the memory, at 0 for a memory of MEMORY_MAX_WORDS,
+    // as SP holds 16 bits.
+    Memory(int32_t size = MEMORY_LIMIT) {
+        this->size = size;
+        this->pages = new MemoryPage*[MEMORY_PAGES];
+        std::fill_n(this->pages, MEMORY_PAGES, Memory::zeroPage());
+        this->ownsPages = true;
+        this->regAX = 0;
+        this->regBX = 0;
+        this->regCX = 0;
+        this->regBP = (int16_t)size;
+        this->regSP = (int16_t)size;
         this->regIP = 0;
+        this->regZF = 0;
+        this->regSF = 0;
+        this->halted = false;
+        this->hartId = 0;
+        this->hartCount = 1;
+        this->codeLimit = 0;
+        this->codeModified = false;
+        this->outputDevice = nullptr;
+        this->outputAt = size;
+        this->doorbell = size;
+    }
+
+    // A copy of other, sharing its pages copy-on-write, or its page table
+    // if other shares the one of another hart.
+    Memory(const Memory& other) {
+        this->pages = nullptr;
+        this->ownsPages = false;
+        *this = other;
+    }
+
+    ~Memory() {
+        this->releasePages();
+    }
+
+    Memory& operator=(const Memory& other) {
+        this->regAX = other.regAX;
+        this->regBX = other.regBX;
+        this->regCX = other.regCX;
+        this->regBP = other.regBP;
+        this->regSP = other.regSP;
+        this->regIP = other.regIP;
+        this->regZF = other.regZF;
+        this->regSF = other.regSF;
+        if (this == &other) {
+            return *this;
+        }
+        this->releasePages();
+        this->size = other.size;
+        this->ownsPages = other.ownsPages;
+        if (other.ownsPages) {
+            this->pages = new MemoryPage*[MEMORY_PAGES];
+            for (int32_t i = 0; i < MEMORY_PAGES; i++) {
+                this->pages[i] = Memory::sharePage(other.pages[i]);
+            }
+        } else {
+            this->pages = other.pages;
+        }
+        this->halted = other.halted;
+        this->hartId = other.hartId;
+        this->hartCount = other.hartCount;
+        this->codeLimit = other.codeLimit;
+        this->codeModified = other.codeModified;
+        this->outputDevice = other.outputDevice;
+        this->outputAt = other.outputAt;
+        this->doorbell = other.doorbell;
+        return *this;
+    }
+
+    /* ------------------------------------------------------------------------
+    * Memory(Memory* shared, int16_t hart, int16_t harts, int16_t stack)
+    * The hart-th of harts harts, sharing the words of shared, which must
+    * outlive it. It starts at the IP of shared, with its stack at stack
+    * and its other registers 0.
+    * The pages of shared are made its own first, so no hart ever has to
+    * copy one while the others use it.
+    * ------------------------------------------------------------------------ */
+    Memory(Memory* shared, int16_t hart, int16_t harts, int16_t stack) {
+        for (int32_t i = 0; i < MEMORY_PAGES; i++) {
+            shared->writablePage(i);
+        }
+        this->size = shared->size;
+        this->pages = shared->pages;
+        this->ownsPages = false;
+        this->regAX = 0;
+        this->regBX = 0;
+        this->regCX = 0;
+        this->regBP = stack;
+        this->regSP = stack;
+        this->regIP = shared->regIP;
+        this->regZF = 0;
+        this->regSF = 0;
+        this->halted = false;
+        this->hartId = hart;
+        this->hartCount = harts;
+        this->codeLimit = 0;
+        this->codeModified = false;
+        this->outputDevice = nullptr;
+        this->outputAt = shared->size;
+        this->doorbell = shared->size;
     }
 
     /* ------------------------------------------------------------------------
@@ -121,7 +343,8 @@ public:
     * value.
     * ------------------------------------------------------------------------ */
     int16_t readMemory(int16_t source) {
-        return this->MEM[source];
+        uint16_t address = (uint16_t)source;
+        return __atomic_load_n(&this->pages[address >> MEMORY_PAGE_SHIFT]->words[address & MEMORY_PAGE_MASK], __ATOMIC_RELAXED);
     }
 
     /* ------------------------------------------------------------------------
@@ -130,8 +353,221 @@ public:
     * returns it's new value (return should be equal to newValue).
     * ------------------------------------------------------------------------ */
     int16_t writeMemory(int16_t destination, int16_t newValue) {
-        this->MEM[destination] = newValue;
-        return this->MEM[destination];
+        MemoryPage* page = this->pages[(uint16_t)destination >> MEMORY_PAGE_SHIFT];
+
+        // One compare tells the plain words, from the end of the code up to
+        // the doorbell, from the ones that need more, and a page shared
+        // needs to be copied first
+        if ((uint16_t)((uint16_t)destination - this->codeLimit) >= (uint32_t)(this->doorbell - this->codeLimit)
+            || __atomic_load_n(&page->references, __ATOMIC_ACQUIRE) != 1) {
+            return this->writeWatched(destination, newValue);
+        }
+        __atomic_store_n(&page->words[destination & MEMORY_PAGE_MASK], newValue, __ATOMIC_RELAXED);
+        return newValue;
+    }
+
+    /* ------------------------------------------------------------------------
+    * int16_t writeWatched(int16_t destination, int16_t newValue)
+    * writeMemory for the words that are not plain: the code, which is then
+    * marked as modified, the doorbell, which is then rung, and the words of
+    * a page shared, which is then copied.
+    * ------------------------------------------------------------------------ */
+    int16_t writeWatched(int16_t destination, int16_t newValue) {
+        uint16_t address = (uint16_t)destination;
+
+        if (address < this->codeLimit) {
+            this->codeModified = true;
+        }
+        __atomic_store_n(this->writableWord(address), newValue, __ATOMIC_RELAXED);
+        if (address == this->doorbell && this->outputDevice != nullptr) {
+            int32_t count = std::max<int32_t>(0, std::min<int32_t>(newValue, this->doorbell - this->outputAt));
+            if ((this->outputAt >> MEMORY_PAGE_SHIFT) == ((this->outputAt + count) >> MEMORY_PAGE_SHIFT)) {
+                this->outputDevice->writeBlock(this->word(this->outputAt), count);
+            } else {
+                // The block crosses a page, it is gathered first
+                std::vector<int16_t> block(count);
+                for (int32_t i = 0; i < count; i++) {
+                    block[i] = *this->word(this->outputAt + i);
+                }
+                this->outputDevice->writeBlock(block.data(), count);
+            }
+        }
+        return newValue;
+    }
+
+    /* ------------------------------------------------------------------------
+    * void mapOutput(Console* device, int16_t words)
+    * Maps the output device, words words long, at the top of the memory,
+    * its doorbell being the last word. The stack starts below it.
+    * ------------------------------------------------------------------------ */
+    void mapOutput(Console* device, int16_t words) {
+        this->outputDevice = device;
+        this->doorbell = this->size - 1;
+        this->outputAt = this->doorbell - words;
+        this->regBP = (int16_t)this->outputAt;
+        this->regSP = (int16_t)this->outputAt;
+    }
+
+    // Returns the first word of the output device, the size if none.
+    int32_t getOutputAt() {
+        return this->outputAt;
+    }
+
+    // Returns the words of the memory.
+    int32_t getSize() {
+        return this->size;
+    }
+
+    // Halts the machine: sets IP past the end of the memory, as far as the
+    // 16 bits go, and marks it halted.
+    void halt() {
+        this->regIP = (int16_t)(this->size + 1);
+        this->halted = true;
+    }
+
+    // Returns true once the machine halted.
+    bool isHalted() {
+        return this->halted;
+    }
+
+    /* ------------------------------------------------------------------------
+    * int32_t fitting(int16_t start, uint16_t count)
+    * Returns how many words of the block of count words at start are
+    * inside the memory, counting from start: 0 if start itself is not.
+    * ------------------------------------------------------------------------ */
+    int32_t fitting(int16_t start, uint16_t count) {
+        if ((uint16_t)start >= this->size) {
+            return 0;
+        }
+        return std::min<int32_t>(count, this->size - (uint16_t)start);
+    }
+
+    /* ------------------------------------------------------------------------
+    * int32_t moveMemory(int16_t destination, int16_t source, uint16_t count)
+    * Copies the block of count words at source to destination, as memmove
+    * does, the blocks may overlap. Stops at the end of the memory, returns
+    * the words copied. The blocks are copied in runs that stay in a page of
+    * each, from the start if destination is below source, else from the end.
+    * ------------------------------------------------------------------------ */
+    int32_t moveMemory(int16_t destination, int16_t source, uint16_t count) {
+        int32_t n = std::min(this->fitting(destination, count), this->fitting(source, count));
+        uint16_t to = (uint16_t)destination, from = (uint16_t)source;
+        bool forward = to < from;
+
+        if (n == 0) {
+            return 0;
+        }
+        if (to < this->codeLimit) {
+            this->codeModified = true;
+        }
+        for (int32_t done = 0; done < n;) {
+            int32_t left = n - done, run, at;
+            if (forward) {
+                at = done;
+                run = std::min(left, MEMORY_PAGE_WORDS - std::max((to + at) & MEMORY_PAGE_MASK, (from + at) & MEMORY_PAGE_MASK));
+            } else {
+                run = std::min(left, std::min(((to + left - 1) & MEMORY_PAGE_MASK) + 1, ((from + left - 1) & MEMORY_PAGE_MASK) + 1));
+                at = left - run;
+            }
+            // The destination first, copying its page may replace the source's
+            int16_t* target = this->writableWord(to + at);
+            int16_t* origin = this->word(from + at);
+            if (this->ownsPages) {
+                memmove(target, origin, run * sizeof(int16_t));
+            } else if (forward) {
+                // Shared with other harts, word by word so no word is ever torn
+                for (int32_t i = 0; i < run; i++) {
+                    __atomic_store_n(&target[i], __atomic_load_n(&origin[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+                }
+            } else {
+                for (int32_t i = run - 1; i >= 0; i--) {
+                    __atomic_store_n(&target[i], __atomic_load_n(&origin[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+                }
+            }
+            done += run;
+        }
+        return n;
+    }
+
+    /* ------------------------------------------------------------------------
+    * int32_t fillMemory(int16_t destination, int16_t value, uint16_t count)
+    * Writes value to the block of count words at destination. Stops at the
+    * end of the memory, returns the words written.
+    * ------------------------------------------------------------------------ */
+    int32_t fillMemory(int16_t destination, int16_t value, uint16_t count) {
+        int32_t n = this->fitting(destination, count);
+        uint16_t to = (uint16_t)destination;
+
+        if (n == 0) {
+            return 0;
+        }
+        if (to < this->codeLimit) {
+            this->codeModified = true;
+        }
+        for (int32_t done = 0; done < n;) {
+            int32_t run = std::min(n - done, MEMORY_PAGE_WORDS - ((to + done) & MEMORY_PAGE_MASK));
+            int16_t* target = this->writableWord(to + done);
+            if (this->ownsPages) {
+                std::fill_n(target, run, value);
+            } else {
+                for (int32_t i = 0; i < run; i++) {
+                    __atomic_store_n(&target[i], value, __ATOMIC_RELAXED);
+                }
+            }
+            done += run;
+        }
+        return n;
+    }
+
+    /* ------------------------------------------------------------------------
+    * int16_t exchangeMemory(int16_t destination, int16_t newValue)
+    * Atomically writes newValue to the memory position destination, and
+    * returns the value it held.
+    * ------------------------------------------------------------------------ */
+    int16_t exchangeMemory(int16_t destination, int16_t newValue) {
+        if ((uint16_t)destination < this->codeLimit) {
+            this->codeModified = true;
+        }
+        return __atomic_exchange_n(this->writableWord((uint16_t)destination), newValue, __ATOMIC_SEQ_CST);
+    }
+
+    /* ------------------------------------------------------------------------
+    * int16_t compareExchangeMemory(int16_t destination, int16_t expected, int16_t newValue)
+    * Atomically writes newValue to the memory position destination if it
+    * holds expected. Returns the value it held, expected if it was written.
+    * ------------------------------------------------------------------------ */
+    int16_t compareExchangeMemory(int16_t destination, int16_t expected, int16_t newValue) {
+        if ((uint16_t)destination < this->codeLimit) {
+            this->codeModified = true;
+        }
+        __atomic_compare_exchange_n(this->writableWord((uint16_t)destination), &expected, newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        return expected;
+    }
+
+    // Orders the memory accesses of this hart before it and after it.
+    void fence() {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+    // Returns the hart's number in the low byte, and how many there are in
+    // the high one.
+    int16_t getHart() {
+        return (int16_t)((this->hartCount << 8) | this->hartId);
+    }
+
+    /* ------------------------------------------------------------------------
+    * void protectCode(int32_t limit)
+    * Marks the words before limit as code. Writing to them afterwards sets
+    * codeModified, see isCodeModified.
+    * ------------------------------------------------------------------------ */
+    void protectCode(int32_t limit) {
+        this->codeLimit = limit;
+        this->codeModified = false;
+    }
+
+    // Returns true if the program wrote over its own code.
+    bool isCodeModified() {
+        return this->codeModified;
     }
 };
 
@@ -0,0 +1,158 @@
+/* Simple86_Linker ModuleLayout
+ *
+ * What the linker keeps of a module between builds: its code,
+ * already encoded, with the places that use names left to be
+ * patched once the module is placed in a program.
+ *
+ */
+
+#ifndef SIMULA_MODULELAYOUT
+#define SIMULA_MODULELAYOUT 1
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include "Instruction.h"
+
+using namespace std;
+
+// Identifies a serialized layout, and its format
+#define LAYOUT_MAGIC "S86L1"
+
+// How a relocation is written once the address of its name is known
+enum RelocationKind{
+    WORD_ADDRESS = 0, // The address as a little endian word
+    HEX_HIGH_BYTE = 1 // One byte, the high byte of the address' decimal text read as hexa
+};
+
+// A place in a module's code that refers to a name
+struct Relocation{
+    uint32_t offset; // Byte inside the module's code
+    RelocationKind kind;
+    string name;
+};
+
+// A name defined by a module, a label or a dw
+struct Definition{
+    InstructionType type; // LABEL or VAR
+    int16_t address; // Address inside the module, for labels
+    string name;
+};
+
+// ModuleLayout of a module of the Simple86 linker
+class ModuleLayout{
+
+    private:
+        // Little endian writers and a bounds checked reader for serialize/deserialize
+        static void putInt(string& out, uint32_t value, int bytes){
+            for(int b = 0; b < bytes; b++){
+                out.push_back((char)(value >> (8 * b)));
+            }
+        }
+
+        static void putString(string& out, const string& s){
+            ModuleLayout::putInt(out, s.size(), 4);
+            out += s;
+        }
+
+        static bool getInt(const string& in, size_t& at, uint32_t& value, int bytes){
+            if(at + bytes > in.size()){
+                return false;
+            }
+            value = 0;
+            for(int b = 0; b < bytes; b++){
+                value |= (uint32_t)(unsigned char)in[at + b] << (8 * b);
+            }
+            at += bytes;
+            return true;
+        }
+
+        static bool getString(const string& in, size_t& at, string& s){
+            uint32_t length;
+            if(!ModuleLayout::getInt(in, at, length, 4) || at + length > in.size()){
+                return false;
+            }
+            s = in.substr(at, length);
+            at += length;
+            return true;
+        }
+
+    public:
+        int16_t sizeInBytes; // Bytes of code, what the module adds to the program
+        vector<Definition> definitions; // In the order they appear in the module
+        string code; // The encoded instructions, names written as 0
+        vector<Relocation> relocations; // Where code uses names
+
+        ModuleLayout(){
+            this->sizeInBytes = 0;
+        }
+
+       /* ------------------------------------------------------------------------
+        * string serialize()
+        * Returns the layout as bytes, to be stored by a BuildCache.
+        * ------------------------------------------------------------------------ */
+        string serialize(){
+            string out = LAYOUT_MAGIC;
+            ModuleLayout::putInt(out, (uint16_t)this->sizeInBytes, 2);
+            ModuleLayout::putInt(out, this->definitions.size(), 4);
+            for(Definition& d : this->definitions){
+                ModuleLayout::putInt(out, d.type, 1);
+                ModuleLayout::putInt(out, (uint16_t)d.address, 2);
+                ModuleLayout::putString(out, d.name);
+            }
+            ModuleLayout::putString(out, this->code);
+            ModuleLayout::putInt(out, this->relocations.size(), 4);
+            for(Relocation& r : this->relocations){
+                ModuleLayout::putInt(out, r.offset, 4);
+                ModuleLayout::putInt(out, r.kind, 1);
+                ModuleLayout::putString(out, r.name);
+            }
+            return out;
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool deserialize(const string& in)
+        * Rebuilds a layout from serialize's output. Returns false if the bytes
+        * are not a complete layout.
+        * ------------------------------------------------------------------------ */
+        bool deserialize(const string& in){
+            size_t at = strlen(LAYOUT_MAGIC);
+            uint32_t value, count;
+
+            if(in.compare(0, at, LAYOUT_MAGIC) != 0 || !ModuleLayout::getInt(in, at, value, 2)){
+                return false;
+            }
+            this->sizeInBytes = (int16_t)value;
+            if(!ModuleLayout::getInt(in, at, count, 4)){
+                return false;
+            }
+            this->definitions.resize(count);
+            for(Definition& d : this->definitions){
+                if(!ModuleLayout::getInt(in, at, value, 1)){
+                    return false;
+                }
+                d.type = (InstructionType)value;
+                if(!ModuleLayout::getInt(in, at, value, 2) || !ModuleLayout::getString(in, at, d.name)){
+                    return false;
+                }
+                d.address = (int16_t)value;
+            }
+            if(!ModuleLayout::getString(in, at, this->code) || !ModuleLayout::getInt(in, at, count, 4)){
+                return false;
+            }
+            this->relocations.resize(count);
+            for(Relocation& r : this->relocations){
+                if(!ModuleLayout::getInt(in, at, r.offset, 4) || !ModuleLayout::getInt(in, at, value, 1)){
+                    return false;
+                }
+                r.kind = (RelocationKind)value;
+                if(!ModuleLayout::getString(in, at, r.name) || r.offset + (r.kind == WORD_ADDRESS ? 2 : 1) > this->code.size()){
+                    return false;
+                }
+            }
+            return at == in.size();
+        }
+};
+
+#endif
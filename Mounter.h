@@ -17,115 +17,179 @@
 #include <cstdint>
 #include <vector>
 #include <iomanip>
+#include <functional>
 #include "Instruction.h"
+#include "Program.h"
+#include "ObjectFile.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
+// Instructions decoded and written at a time by mountStreaming
+#define STREAM_WINDOW 4096
+
 // Mounter module for Simple86
 class Mounter{
 
     private:
-        ifstream* input; // input file
-        ofstream* output; // outputfile
-        vector<Instruction> program; // Program is an array of Instructions
+        istream* input; // input file, or any stream with the source
+        ostream* output; // outputfile, or any stream taking the object
+        Program program; // The program, in the compact representation
         int16_t programSizeInBytes; // Total number of bytes this program has
         bool verboseEnabled; // -v flag
+        ostream* log; // Where the verbose output goes
+        ThreadPool* pool; // Workers decoding and encoding chunks, may be null
+        bool optimizeEnabled; // -O flag
 
     public:
 
        /* ------------------------------------------------------------------------
-        * Mounter(ifstream* input, ofstream* output, bool verboseEnabled)
-        * Instantializes a Mounter object that knows it's IO files and the -v flag
+        * Mounter(istream* input, ostream* output, bool verboseEnabled, ostream* log, ThreadPool* pool, bool optimizeEnabled)
+        * Instantializes a Mounter object that knows it's IO files, the -v flag,
+        * where to write the verbose output and, optionally, the threads to
+        * split the work of a large program among and the -O flag.
         * ------------------------------------------------------------------------ */
-        Mounter(ifstream* input, ofstream* output, bool verboseEnabled){
+        Mounter(istream* input, ostream* output, bool verboseEnabled, ostream* log = &cout, ThreadPool* pool = nullptr, bool optimizeEnabled = false){
             this->input = input;
             this->output = output;
             this->program.clear();
             this->programSizeInBytes = 0;
             this->verboseEnabled = verboseEnabled;
+            this->log = log;
+            this->pool = pool;
+            this->optimizeEnabled = optimizeEnabled;
         }
 
        /* ------------------------------------------------------------------------
-        * void readProgram(ifstream* input)
-        * Reads a program from a text file and populates the vector<Instruction> program
+        * void readProgram(istream* input)
+        * Reads a program from a text file and populates the Program program
         * object. The first compilation pass. Ends with all instructions and commands
         * partially decoded, but labels still don't know the address they represent.
+        * The lines are split into chunks, each chunk is decoded on its own,
+        * addressed from 0, then moved to its place, given by the sum of the sizes
+        * of the chunks before it.
         * ------------------------------------------------------------------------ */
-        void readProgram(ifstream* input){
+        void readProgram(istream* input){
+            vector<string> lines;
             string str;
-            int split;
 
-            if(this->verboseEnabled){
-                cout << "The following commands were read:" << endl;
-                cout << left << setw(15) << setfill(' ') << "Pred. Address";
-                cout << left << setw(10) << setfill(' ') << "Command" << endl;
-            }
             // Reads peer line
             while(getline(*input, str)){
-                // This if detects it there is a label at the current line
-                // splits the label and instruction into two different
-                // strings
-                if(str.at(0) == '_'){
-                    split = str.find( ":", 0);
-                    // Label decode
-                    this->program.push_back(Instruction(str.substr(0,split)));
-                    this->program.back().address = programSizeInBytes / 2;
-                    if(this->verboseEnabled){
-                        this->debugReceivedInstruction(this->program.back());
-                    }
-                    // The instruction after the label.
-                    str = str.substr(split+1,str.size());
-                    if(str.empty()){
-                        continue;
-                    }
-                    if(str.at(0) == ' '){
-                        str = str.substr(1,str.size());
-                    }
-                }
-                // Instruction decode
-                this->program.push_back(Instruction(str));
-                // Address computation
-                this->program.back().address = programSizeInBytes / 2;
-                this->programSizeInBytes += this->bitSpaceToBytes(program.back().size);
-                if(this->verboseEnabled){
-                    this->debugReceivedInstruction(this->program.back());
+                lines.push_back(str);
+            }
+
+            size_t chunks = this->pool == nullptr ? 1 : this->pool->size();
+            vector<Program> parts(chunks);
+            vector<int16_t> sizes(chunks, 0);
+
+            this->forEachChunk(chunks, [&](size_t k){
+                size_t begin = lines.size() * k / chunks;
+                size_t end = lines.size() * (k + 1) / chunks;
+                for(size_t l = begin; l < end; l++){
+                    this->readLine(lines[l], parts[k], sizes[k]);
                 }
+            });
+
+            // Prefix sum over the chunk sizes
+            for(size_t k = 0; k < chunks; k++){
+                this->program.append(parts[k], this->programSizeInBytes / 2);
+                this->programSizeInBytes += sizes[k];
             }
+
             if(this->verboseEnabled){
-                cout << endl;
+                *this->log << "The following commands were read:" << endl;
+                *this->log << left << setw(15) << setfill(' ') << "Pred. Address";
+                *this->log << left << setw(10) << setfill(' ') << "Command" << endl;
+                for(size_t k = 0; k < this->program.count(); k++){
+                    this->debugReceivedInstruction(k);
+                }
+                *this->log << endl;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * void readLine(string str, Program& part, int16_t& sizeInBytes)
+        * Decodes one line of the program at the end of part, which is sizeInBytes
+        * long so far, and adds its size to sizeInBytes.
+        * ------------------------------------------------------------------------ */
+        void readLine(string str, Program& part, int16_t& sizeInBytes){
+            int split;
+            Instruction decoded;
+
+            // This if detects it there is a label at the current line
+            // splits the label and instruction into two different
+            // strings
+            if(str.at(0) == '_'){
+                split = str.find( ":", 0);
+                // Label decode
+                decoded = Instruction(str.substr(0,split));
+                decoded.address = sizeInBytes / 2;
+                part.append(decoded);
+                // The instruction after the label.
+                str = str.substr(split+1,str.size());
+                if(str.empty()){
+                    return;
+                }
+                if(str.at(0) == ' '){
+                    str = str.substr(1,str.size());
+                }
+            }
+            // Instruction decode
+            decoded = Instruction(str);
+            // Address computation
+            decoded.address = sizeInBytes / 2;
+            sizeInBytes += this->bitSpaceToBytes(decoded.size);
+            part.append(decoded);
+        }
+
+       /* ------------------------------------------------------------------------
+        * void forEachChunk(size_t chunks, function<void(size_t)> body)
+        * Calls body for each chunk, on the pool if there is one.
+        * ------------------------------------------------------------------------ */
+        void forEachChunk(size_t chunks, function<void(size_t)> body){
+            if(this->pool == nullptr){
+                for(size_t k = 0; k < chunks; k++){
+                    body(k);
+                }
+                return;
             }
+            this->pool->parallelFor(chunks, [&body](size_t begin, size_t end){
+                for(size_t k = begin; k < end; k++){
+                    body(k);
+                }
+            });
         }
 
        /* ------------------------------------------------------------------------
-        * void resolveLocalLabels(vector<Instruction>& instructions)
+        * void resolveLocalLabels(Program& instructions)
         * Detects labels and words. Does not compute their addresses because the
         * linker will do so in the future.
         * ------------------------------------------------------------------------ */
-        void resolveLocalLabels(vector<Instruction>& instructions){
+        void resolveLocalLabels(Program& instructions){
             if(this->verboseEnabled){
-                cout << left << "Table of names " << setw(15) << setfill('=') << '=' << endl;
-                cout << left << setw(15) << setfill(' ') << "Name";
-                cout << left << setw(15) << setfill(' ') << "Address" << endl;                
+                *this->log << left << "Table of names " << setw(15) << setfill('=') << '=' << endl;
+                *this->log << left << setw(15) << setfill(' ') << "Name";
+                *this->log << left << setw(15) << setfill(' ') << "Address" << endl;                
             }
 
             // Searches for labels and dws, passing by each instruction
-            for(Instruction& i : instructions){
-                if(i.type == InstructionType::LABEL || i.type == InstructionType::VAR){
-                    if(i.type == InstructionType::VAR){
+            for(size_t i = 0; i < instructions.count(); i++){
+                if(instructions.type[i] == InstructionType::LABEL || instructions.type[i] == InstructionType::VAR){
+                    if(instructions.type[i] == InstructionType::VAR){
                         // Variables are stored after the program. The program is stored at 0
-                        i.address = this->programSizeInBytes / 2;
+                        instructions.address[i] = this->programSizeInBytes / 2;
                         this->programSizeInBytes += 2;
                     }
 
                     if(this->verboseEnabled){
-                        cout << left << setw(15) << setfill(' ') << i.id;
-                        cout << left << setw(15) << setfill(' ') << i.address << endl;
+                        *this->log << left << setw(15) << setfill(' ') << instructions.symbols.str(instructions.id[i]);
+                        *this->log << left << setw(15) << setfill(' ') << instructions.address[i] << endl;
                     }
                 }
             }
 
             if(this->verboseEnabled){
-                cout << left << setw(30) << setfill('=') << '=' << endl << endl;
+                *this->log << left << setw(30) << setfill('=') << '=' << endl << endl;
             }
         }
 
@@ -133,47 +197,272 @@ class Mounter{
         * int mount()
         * Applies the first and second pass to the program received, generating a
         * binary. This function coordinates the compilation process, which begins
-        * with an input file, passes through an array of Instruction objects
-        * representing what has been processed so far, and ends with a fully processed
-        * vector which is transformed into a object file for the linker to use.
+        * with an input file, passes through a Program representing what has been
+        * processed so far, and ends with a fully processed program which is
+        * transformed into a object file for the linker to use.
         * ------------------------------------------------------------------------ */
         int mount(){
             this->readProgram(this->input); // First step
+            if(this->optimizeEnabled){
+                this->optimize(this->program);
+            }
             this->resolveLocalLabels(this->program); // Second step
             
-            // Writes the end results inside the vector<Instruction> program
+            // Writes the end results inside the Program program
             if(this->verboseEnabled){
                 this->writeTextOutput(this->program);
             }
 
-            // Transforms the vector<Instruction> program into a real program output
+            // Transforms the Program program into a real program output
             // to the output file.
             this->writeObject(this->program);
 
-            input->close();
-            output->close();
+            output->flush();
+            return 1;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void optimize(Program& instructions)
+        * The peephole optimizer, run between the two passes when -O is given.
+        * Removes, until none is left:
+        *   MOV r, r
+        *   a MOV to a register written by the next MOV, which doesn't read it
+        *   ADD r, 0x0 whose flags are written again before anything reads them
+        *   JMP to a label right after it
+        *   PUSH r directly followed by POP r
+        * A label between two instructions keeps them apart, something may jump
+        * between them. A store to memory is never removed: the word may be a
+        * device's, see Memory.h, where every write counts. Addresses are then
+        * computed again.
+        * ------------------------------------------------------------------------ */
+        void optimize(Program& instructions){
+            size_t removedCount = 0, removedBytes = 0, found;
+
+            do{
+                vector<char> removed(instructions.count(), 0);
+                vector<size_t> firstDefinition(instructions.symbols.size(), instructions.count());
+                found = 0;
+
+                // Only the first definition of a name in the module is the one jumped to
+                for(size_t k = 0; k < instructions.count(); k++){
+                    if(instructions.type[k] == InstructionType::LABEL && firstDefinition[instructions.id[k]] == instructions.count()){
+                        firstDefinition[instructions.id[k]] = k;
+                    }
+                }
+                for(size_t k = 0; k < instructions.count(); k++){
+                    if(!removed[k] && instructions.type[k] == InstructionType::INSTRUCTION){
+                        found += this->peephole(instructions, k, removed, firstDefinition);
+                    }
+                }
+                for(size_t k = 0; k < instructions.count(); k++){
+                    if(removed[k]){
+                        removedBytes += this->bitSpaceToBytes(instructions.size[k]);
+                    }
+                }
+                removedCount += found;
+                instructions.removeMarked(removed);
+            }while(found > 0);
+
+            // Addresses of the instructions and labels that were after the removed ones
+            this->programSizeInBytes = 0;
+            for(size_t k = 0; k < instructions.count(); k++){
+                instructions.address[k] = this->programSizeInBytes / 2;
+                this->programSizeInBytes += this->bitSpaceToBytes(instructions.size[k]);
+            }
+
+            if(this->verboseEnabled){
+                *this->log << "Peephole optimizer removed " << removedCount << " instructions, " << removedBytes << " bytes." << endl << endl;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * size_t peephole(Program& p, size_t k, vector<char>& removed, vector<size_t>& firstDefinition)
+        * Applies the patterns of optimize to the k-th instruction and the ones
+        * after it, marking what can go in removed. Returns how many were marked.
+        * ------------------------------------------------------------------------ */
+        size_t peephole(Program& p, size_t k, vector<char>& removed, vector<size_t>& firstDefinition){
+            OperandType opType = (OperandType)p.opType[k];
+            size_t next = this->nextEntry(p, k, removed);
+            bool nextIsInstruction = next < p.count() && p.type[next] == InstructionType::INSTRUCTION;
+
+            switch(p.code[k]){
+                case InstructionCode::MOV:
+                    if(opType == OperandType::RR && p.textA[k] == p.textB[k]){
+                        removed[k] = 1;
+                        return 1;
+                    }
+                    // Unless the second MOV reads what the first wrote, as a register
+                    // or as the BX of an indexed operand
+                    if(nextIsInstruction && p.code[next] == InstructionCode::MOV && p.textA[next] == p.textA[k]
+                       && Program::kindOfA(opType) == REGISTER_OPERAND
+                       && Program::kindOfA((OperandType)p.opType[next]) == Program::kindOfA(opType)
+                       && !(Program::kindOfA(opType) == REGISTER_OPERAND && Program::kindOfB((OperandType)p.opType[next]) == REGISTER_OPERAND
+                            && this->sameRegister(p.symbols.str(p.textA[k]), p.symbols.str(p.textB[next])))
+                       && !(Program::kindOfA(opType) == REGISTER_OPERAND && Program::kindOfB((OperandType)p.opType[next]) == INDEXED_OPERAND
+                            && this->sameRegister(p.symbols.str(p.textA[k]), "bx"))){
+                        removed[k] = 1;
+                        return 1;
+                    }
+                    return 0;
+                case InstructionCode::ADD:
+                    if(opType == OperandType::RI && Program::operandValue(IMMEDIATE_OPERAND, p.symbols.str(p.textB[k])) == 0
+                       && this->flagsRewritten(p, k, removed)){
+                        removed[k] = 1;
+                        return 1;
+                    }
+                    return 0;
+                case InstructionCode::JUMP:
+                    // The labels before the next instruction are at the address after the JMP
+                    for(size_t l = next; l < p.count() && p.type[l] != InstructionType::INSTRUCTION; l = this->nextEntry(p, l, removed)){
+                        if(p.id[l] == p.textA[k] && firstDefinition[p.id[l]] == l){
+                            removed[k] = 1;
+                            return 1;
+                        }
+                    }
+                    return 0;
+                case InstructionCode::PUSH:
+                    if(nextIsInstruction && p.code[next] == InstructionCode::POP && p.opType[next] == opType
+                       && opType == OperandType::R && p.textA[next] == p.textA[k]){
+                        removed[k] = 1;
+                        removed[next] = 1;
+                        return 2;
+                    }
+                    return 0;
+                default:
+                    return 0;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * size_t nextEntry(Program& p, size_t k, vector<char>& removed)
+        * Index of the instruction or label that follows the k-th entry, or
+        * p.count() if there is none. dws are stored after the program, they
+        * are skipped.
+        * ------------------------------------------------------------------------ */
+        size_t nextEntry(Program& p, size_t k, vector<char>& removed){
+            size_t n = k + 1;
+            while(n < p.count() && (removed[n] || p.type[n] == InstructionType::VAR)){
+                n++;
+            }
+            return n;
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool flagsRewritten(Program& p, size_t k, vector<char>& removed)
+        * True if, going straight on from the k-th instruction, ZF and SF are
+        * written again before anything may read them: a jump, a call, a label,
+        * the end of the program, or DUMP, which shows them.
+        * ------------------------------------------------------------------------ */
+        bool flagsRewritten(Program& p, size_t k, vector<char>& removed){
+            for(size_t n = this->nextEntry(p, k, removed); n < p.count(); n = this->nextEntry(p, n, removed)){
+                if(p.type[n] != InstructionType::INSTRUCTION){
+                    return false;
+                }
+                switch(p.code[n]){
+                    case InstructionCode::ADD:
+                    case InstructionCode::SUB:
+                    case InstructionCode::AND:
+                    case InstructionCode::OR:
+                    case InstructionCode::NOT:
+                    case InstructionCode::CMP: return true;
+                    case InstructionCode::MOV:
+                    case InstructionCode::MUL:
+                    case InstructionCode::DIV:
+                    case InstructionCode::PUSH:
+                    case InstructionCode::POP:
+                    case InstructionCode::READ:
+                    case InstructionCode::WRITE: break;
+                    default: return false;
+                }
+            }
+            return false;
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool sameRegister(string a, string b)
+        * True if two registers share bits, e.g. AX and AL.
+        * ------------------------------------------------------------------------ */
+        bool sameRegister(string a, string b){
+            return !a.empty() && !b.empty() && a.at(0) == b.at(0);
+        }
+
+       /* ------------------------------------------------------------------------
+        * int mountStreaming()
+        * Same as mount(), in a single pass: records are encoded and written as
+        * the lines arrive, a window of STREAM_WINDOW instructions at a time.
+        * Labels know their address when read, but dws are stored after the
+        * program, so their records are written with address 0 and kept on a
+        * list of fixups, patched once the size of the program is known. Memory
+        * is bounded by the window and the number of dws, not the program size.
+        * There is no verbose output, it needs the whole program.
+        * ------------------------------------------------------------------------ */
+        int mountStreaming(){
+            Program window;
+            vector<size_t> fixups; // Records of the dws, in program order
+            size_t records = 0; // Records written so far
+            int16_t address;
+            string str;
+
+            while(getline(*this->input, str)){
+                this->readLine(str, window, this->programSizeInBytes);
+                if(window.count() >= STREAM_WINDOW){
+                    this->writeWindow(window, records, fixups);
+                }
+            }
+            this->writeWindow(window, records, fixups);
+
+            // Backpatches the dws, stored after the program in the order they were read
+            for(size_t record : fixups){
+                address = this->programSizeInBytes / 2;
+                this->programSizeInBytes += 2;
+                this->output->seekp(record * OBJECT_RECORD_SIZE + OBJECT_ADDRESS_AT);
+                this->output->write((const char*)&address, sizeof(int16_t));
+            }
+
+            output->flush();
             return 1;
         }
 
        /* ------------------------------------------------------------------------
-        * void writeTextOutput(vector<Instruction> program)
-        * Outputs all the Instructions inside the vector. Used after the second pass
+        * void writeWindow(Program& window, size_t& records, vector<size_t>& fixups)
+        * Writes the records of the instructions in window, which follow the
+        * records already written, noting the dws among them in fixups. The
+        * window is emptied.
+        * ------------------------------------------------------------------------ */
+        void writeWindow(Program& window, size_t& records, vector<size_t>& fixups){
+            string buffer(window.count() * OBJECT_RECORD_SIZE, 0);
+
+            for(size_t n = 0; n < window.count(); n++){
+                if(window.type[n] == InstructionType::VAR){
+                    window.address[n] = 0;
+                    fixups.push_back(records + n);
+                }
+                this->encodeRecord(window, n, &buffer[n * OBJECT_RECORD_SIZE]);
+            }
+            this->output->write(buffer.data(), buffer.size());
+            records += window.count();
+            window.clear();
+        }
+
+       /* ------------------------------------------------------------------------
+        * void writeTextOutput(Program& program)
+        * Outputs all the instructions inside the program. Used after the second pass
         * to show what has been understood by the mounter, and to what the labels
         * were resolved to.
         * ------------------------------------------------------------------------ */
-        void writeTextOutput(vector<Instruction> program){
+        void writeTextOutput(Program& program){
             // Everything output as table
-            cout << "The following program will be written in binary:" << endl;
-            cout << left << setw(15) << setfill(' ') << "Address";
-            cout << left << setw(30) << setfill(' ') << "Command";
-            cout << left << setw(10) << setfill(' ') << "Size (bytes)" << endl;
-            for(Instruction& ins : program){
+            *this->log << "The following program will be written in binary:" << endl;
+            *this->log << left << setw(15) << setfill(' ') << "Address";
+            *this->log << left << setw(30) << setfill(' ') << "Command";
+            *this->log << left << setw(10) << setfill(' ') << "Size (bytes)" << endl;
+            for(size_t ins = 0; ins < program.count(); ins++){
                 // VAR and LABEL have 0 bits as size, and won't be output to binary, only
                 // the addresses those resolve to.
-                if(ins.type != InstructionType::VAR && ins.type != InstructionType::LABEL){
-                    cout << left << setw(15) << setfill(' ') << ins.address;
-                    cout << left << setw(30) << setfill(' ') << ins.debugInstruction();
-                    cout << left << setw(10) << setfill(' ') << this->bitSpaceToBytes(ins.size) << endl;
+                if(program.type[ins] != InstructionType::VAR && program.type[ins] != InstructionType::LABEL){
+                    *this->log << left << setw(15) << setfill(' ') << program.address[ins];
+                    *this->log << left << setw(30) << setfill(' ') << program.debugInstruction(ins);
+                    *this->log << left << setw(10) << setfill(' ') << this->bitSpaceToBytes(program.size[ins]) << endl;
                 }
             }
         }
@@ -188,48 +477,63 @@ class Mounter{
         }
 
        /* ------------------------------------------------------------------------
-        * void writeBin(vector<Instruction> toWrite)
-        * Transforms the vector into a binary program output to the linker program.
+        * void writeObject(Program& toWrite)
+        * Transforms the program into a binary program output to the linker program.
+        * Records have a fixed size, so each chunk of the program is encoded in
+        * place in a single buffer, written at once.
         * ------------------------------------------------------------------------ */
-        void writeObject(vector<Instruction> toWrite){
-            // for each instruction inside the vector
-            for(Instruction& i : toWrite){
-                char fullText[128] = { 0 };
-                char id[128] = { 0 };
-                char opA[128] = { 0 };
-                char opB[128] = { 0 };
-                i.fullText.copy(fullText,i.fullText.size(),0);
-                i.id.copy(id,i.id.size(),0);
-                i.opA.copy(opA,i.opA.size(),0);
-                i.opB.copy(opB,i.opB.size(),0);
-                this->output->write((char *)fullText, sizeof(char)*128);
-                this->output->write((char *)id, sizeof(char)*128);
-                this->output->write((char *)opA, sizeof(char)*128);
-                this->output->write((char *)opB, sizeof(char)*128);
-                this->output->write((char *)(&i.type), sizeof(InstructionType));
-                this->output->write((char *)(&i.code), sizeof(InstructionCode));
-                this->output->write((char *)(&i.opType), sizeof(OperandType));
-                this->output->write((char *)(&i.address),sizeof(int16_t));
-                this->output->write((char *)(&i.size), sizeof(int16_t));
-            }
+        void writeObject(Program& toWrite){
+            size_t chunks = this->pool == nullptr ? 1 : this->pool->size();
+            string buffer(toWrite.count() * OBJECT_RECORD_SIZE, 0);
+
+            this->forEachChunk(chunks, [&](size_t k){
+                size_t begin = toWrite.count() * k / chunks;
+                size_t end = toWrite.count() * (k + 1) / chunks;
+                for(size_t n = begin; n < end; n++){
+                    this->encodeRecord(toWrite, n, &buffer[n * OBJECT_RECORD_SIZE]);
+                }
+            });
+            this->output->write(buffer.data(), buffer.size());
+        }
+
+       /* ------------------------------------------------------------------------
+        * void encodeRecord(Program& p, size_t i, char* record)
+        * Writes the object file record of the i-th instruction, OBJECT_RECORD_SIZE
+        * zeroed bytes long. Texts longer than their field are cut.
+        * ------------------------------------------------------------------------ */
+        void encodeRecord(Program& p, size_t i, char* record){
+            InstructionType type = (InstructionType)p.type[i];
+            InstructionCode code = (InstructionCode)p.code[i];
+            OperandType opType = (OperandType)p.opType[i];
+            int16_t size = p.size[i];
+
+            p.symbols.str(p.fullText[i]).copy(record + OBJECT_FULLTEXT_AT, OBJECT_TEXT_SIZE, 0);
+            p.symbols.str(p.id[i]).copy(record + OBJECT_ID_AT, OBJECT_TEXT_SIZE, 0);
+            p.symbols.str(p.textA[i]).copy(record + OBJECT_OPA_AT, OBJECT_TEXT_SIZE, 0);
+            p.symbols.str(p.textB[i]).copy(record + OBJECT_OPB_AT, OBJECT_TEXT_SIZE, 0);
+            memcpy(record + OBJECT_TYPE_AT, &type, sizeof(InstructionType));
+            memcpy(record + OBJECT_CODE_AT, &code, sizeof(InstructionCode));
+            memcpy(record + OBJECT_OPTYPE_AT, &opType, sizeof(OperandType));
+            memcpy(record + OBJECT_ADDRESS_AT, &p.address[i], sizeof(int16_t));
+            memcpy(record + OBJECT_SIZE_AT, &size, sizeof(int16_t));
         }
 
         /* ------------------------------------------------------------------------
-        * void debugReceivedInstruction(Instruction& i)
-        * Prints (formatted) a Instruction and what is inside it so far.
+        * void debugReceivedInstruction(size_t i)
+        * Prints (formatted) the i-th instruction and what is inside it so far.
         * Used at the first step if verbose is enabled.
         * ------------------------------------------------------------------------ */
-        void debugReceivedInstruction(Instruction& i){
-            string ops = i.id;
-            if(!i.opA.empty()){
-                ops += " " + i.opA;
+        void debugReceivedInstruction(size_t i){
+            string ops = this->program.symbols.str(this->program.id[i]);
+            if(!this->program.symbols.empty(this->program.textA[i])){
+                ops += " " + this->program.operandText(this->program.textA[i], Program::kindOfA((OperandType)this->program.opType[i]));
             }
-            if(!i.opB.empty()){
-                ops += ", " + i.opB;
+            if(!this->program.symbols.empty(this->program.textB[i])){
+                ops += ", " + this->program.operandText(this->program.textB[i], Program::kindOfB((OperandType)this->program.opType[i]));
             }
-            cout << left << setw(15) << setfill(' ') << i.address;
-            cout << left << setw(10) << setfill(' ') << ops;
-            cout << endl;
+            *this->log << left << setw(15) << setfill(' ') << this->program.address[i];
+            *this->log << left << setw(10) << setfill(' ') << ops;
+            *this->log << endl;
         }
 };
 
@@ -0,0 +1,214 @@
+/* Simple86_Compiler ObjectFile
+ *
+ * Read-only access to the object files written by the Mounter.
+ * The file is mapped into memory and its records are read in
+ * place, as views, without copying them.
+ *
+ */
+
+#ifndef SIMULA_OBJECTFILE
+#define SIMULA_OBJECTFILE 1
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Instruction.h"
+
+using namespace std;
+
+// Length of each text field of a record, see Mounter::writeObject
+#define OBJECT_TEXT_SIZE 128
+
+// Offsets of the fields inside a record, in the order the Mounter writes them
+#define OBJECT_FULLTEXT_AT 0
+#define OBJECT_ID_AT (OBJECT_FULLTEXT_AT + OBJECT_TEXT_SIZE)
+#define OBJECT_OPA_AT (OBJECT_ID_AT + OBJECT_TEXT_SIZE)
+#define OBJECT_OPB_AT (OBJECT_OPA_AT + OBJECT_TEXT_SIZE)
+#define OBJECT_TYPE_AT (OBJECT_OPB_AT + OBJECT_TEXT_SIZE)
+#define OBJECT_CODE_AT (OBJECT_TYPE_AT + sizeof(InstructionType))
+#define OBJECT_OPTYPE_AT (OBJECT_CODE_AT + sizeof(InstructionCode))
+#define OBJECT_ADDRESS_AT (OBJECT_OPTYPE_AT + sizeof(OperandType))
+#define OBJECT_SIZE_AT (OBJECT_ADDRESS_AT + sizeof(int16_t))
+#define OBJECT_RECORD_SIZE (OBJECT_SIZE_AT + sizeof(int16_t))
+
+// A text field of a record, seen in place. Not always null terminated,
+// a field filling all its OBJECT_TEXT_SIZE chars has no terminator.
+struct ObjectText{
+    const char* text;
+    size_t length;
+
+    bool empty() const{
+        return this->length == 0;
+    }
+
+    string str() const{
+        return string(this->text, this->length);
+    }
+
+    // Views a string owned by someone else, which must outlive the view.
+    static ObjectText of(const string& s){
+        ObjectText t;
+        t.text = s.data();
+        t.length = s.size();
+        return t;
+    }
+};
+
+// A record of an object file, one line of the assembly, seen in place.
+struct ObjectRecord{
+    ObjectText fullText; // Line read from the input
+    ObjectText id; // The instruction code as string, or some label
+    ObjectText opA, opB; // The possible operands of a instruction
+    InstructionType type;
+    InstructionCode code;
+    OperandType opType;
+    int16_t address; // Address, considering a word has 16 bits
+    int16_t size; // The size, in bits, of this instruction
+
+   /* ------------------------------------------------------------------------
+    * string debugRecord()
+    * Same as Instruction::debugInstruction, for a record.
+    * ------------------------------------------------------------------------ */
+    string debugRecord() const{
+        string str = this->id.str();
+        if(!(this->opA.empty())){
+            str += ' ' + this->opA.str();
+        }
+        if(!(this->opB.empty())){
+            str += ", " + this->opB.str();
+        }
+
+        // String is in upper case
+        transform(str.begin(), str.end(), str.begin(), ::toupper);
+
+        return str;
+    }
+};
+
+// An object file produced by the Mounter, mapped into memory
+class ObjectFile{
+
+    private:
+        const char* data; // Start of the mapping
+        size_t length; // Bytes mapped
+        bool mapped; // False if the file could not be opened
+        bool owned; // False for a view of bytes mapped by someone else
+
+       /* ------------------------------------------------------------------------
+        * ObjectText textAt(const char* record, size_t offset)
+        * Returns the text field starting offset bytes inside a record.
+        * ------------------------------------------------------------------------ */
+        ObjectText textAt(const char* record, size_t offset){
+            ObjectText t;
+            t.text = record + offset;
+            const char* end = (const char*)memchr(t.text, 0, OBJECT_TEXT_SIZE);
+            t.length = end == nullptr ? OBJECT_TEXT_SIZE : end - t.text;
+            return t;
+        }
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * ObjectFile(string fileName)
+        * Maps the file read-only. An empty file is valid and has no records.
+        * ------------------------------------------------------------------------ */
+        ObjectFile(string fileName){
+            struct stat info;
+            int fd = open(fileName.c_str(), O_RDONLY);
+
+            this->data = nullptr;
+            this->length = 0;
+            this->mapped = false;
+            this->owned = true;
+            if(fd < 0){
+                return;
+            }
+            if(fstat(fd, &info) == 0){
+                this->length = info.st_size;
+                if(this->length == 0){
+                    this->mapped = true;
+                }else{
+                    void* m = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if(m != MAP_FAILED){
+                        this->data = (const char*)m;
+                        this->mapped = true;
+                        madvise(m, this->length, MADV_SEQUENTIAL);
+                    }
+                }
+            }
+            close(fd);
+        }
+
+       /* ------------------------------------------------------------------------
+        * ObjectFile(const char* data, size_t length)
+        * Views an object already in memory, e.g. a member of an archive. The
+        * bytes must outlive the ObjectFile.
+        * ------------------------------------------------------------------------ */
+        ObjectFile(const char* data, size_t length){
+            this->data = data;
+            this->length = length;
+            this->mapped = true;
+            this->owned = false;
+        }
+
+        ~ObjectFile(){
+            if(this->owned && this->data != nullptr){
+                munmap((void*)this->data, this->length);
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool isOpen()
+        * Returns true if the file was mapped.
+        * ------------------------------------------------------------------------ */
+        bool isOpen(){
+            return this->mapped;
+        }
+
+       /* ------------------------------------------------------------------------
+        * const char* bytes()
+        * The raw contents of the file, size() bytes long.
+        * ------------------------------------------------------------------------ */
+        const char* bytes(){
+            return this->data;
+        }
+
+        size_t size(){
+            return this->length;
+        }
+
+       /* ------------------------------------------------------------------------
+        * size_t recordCount()
+        * Number of complete records in the file.
+        * ------------------------------------------------------------------------ */
+        size_t recordCount(){
+            return this->length / OBJECT_RECORD_SIZE;
+        }
+
+       /* ------------------------------------------------------------------------
+        * ObjectRecord record(size_t k)
+        * Returns a view of the k-th record. The view is valid while this
+        * ObjectFile exists.
+        * ------------------------------------------------------------------------ */
+        ObjectRecord record(size_t k){
+            ObjectRecord r;
+            const char* at = this->data + k * OBJECT_RECORD_SIZE;
+            r.fullText = this->textAt(at, OBJECT_FULLTEXT_AT);
+            r.id = this->textAt(at, OBJECT_ID_AT);
+            r.opA = this->textAt(at, OBJECT_OPA_AT);
+            r.opB = this->textAt(at, OBJECT_OPB_AT);
+            // The numeric fields are not aligned inside the record
+            memcpy(&r.type, at + OBJECT_TYPE_AT, sizeof(InstructionType));
+            memcpy(&r.code, at + OBJECT_CODE_AT, sizeof(InstructionCode));
+            memcpy(&r.opType, at + OBJECT_OPTYPE_AT, sizeof(OperandType));
+            memcpy(&r.address, at + OBJECT_ADDRESS_AT, sizeof(int16_t));
+            memcpy(&r.size, at + OBJECT_SIZE_AT, sizeof(int16_t));
+            return r;
+        }
+};
+
+#endif
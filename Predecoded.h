@@ -0,0 +1,236 @@
+/* Simple86_Compiler Predecoded
+ *
+ * The predecoded section of an executable. The linker can append,
+ * after the program, one record per word of code telling what
+ * instruction starts there, already split into its fields, and
+ * where basic blocks start. The emulator maps the file read-only
+ * and runs from these records instead of decoding each fetch, so
+ * many emulators running a program share the same pages.
+ *
+ */
+
+#ifndef SIMULA_PREDECODED
+#define SIMULA_PREDECODED 1
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Starts the section, and ends the file, followed by the section's offset
+#define PREDECODED_MAGIC "S86D1\0\0\0"
+#define PREDECODED_MAGIC_SIZE 8
+#define PREDECODED_FOOTER_SIZE 16
+
+// Flags of a record
+#define PREDECODED_INSTRUCTION 1 // An instruction starts at this word
+#define PREDECODED_BLOCK_START 2 // and it starts a basic block
+
+// What the emulator would decode at a word of code
+struct PredecodedInstruction{
+    int8_t opCode;
+    int8_t operandType;
+    uint8_t flags;
+    uint8_t length; // In words
+    int16_t op1, op2;
+};
+
+// Layout of the section, numbers are little endian:
+//   magic, uint32 recordCount, uint32 0, recordCount PredecodedInstruction
+// and of the footer, the last bytes of the file:
+//   uint64 offset of the section, magic
+
+// A predecoded executable, mapped into memory
+class PredecodedImage{
+
+    private:
+        const char* data; // Start of the mapping
+        size_t length; // Bytes mapped
+        uint64_t sectionAt; // Offset of the section, 0 if there is none
+        uint32_t records; // Records in the section
+        bool owned; // Whether the bytes were mapped by this object
+
+       /* ------------------------------------------------------------------------
+        * void locate()
+        * Finds the predecoded section from the footer, if the bytes end with
+        * a valid one.
+        * ------------------------------------------------------------------------ */
+        void locate(){
+            if(this->data == nullptr || this->length < PREDECODED_FOOTER_SIZE + PREDECODED_MAGIC_SIZE + 8){
+                return;
+            }
+
+            const char* footer = this->data + this->length - PREDECODED_FOOTER_SIZE;
+            uint64_t at;
+            uint32_t count;
+            memcpy(&at, footer, sizeof(uint64_t));
+            if(memcmp(footer + 8, PREDECODED_MAGIC, PREDECODED_MAGIC_SIZE) != 0 || at % 8 != 0
+               || at + PREDECODED_MAGIC_SIZE + 8 > this->length - PREDECODED_FOOTER_SIZE
+               || memcmp(this->data + at, PREDECODED_MAGIC, PREDECODED_MAGIC_SIZE) != 0){
+                return;
+            }
+            memcpy(&count, this->data + at + PREDECODED_MAGIC_SIZE, sizeof(uint32_t));
+            if((uint64_t)count * sizeof(PredecodedInstruction) > this->length - PREDECODED_FOOTER_SIZE - at - PREDECODED_MAGIC_SIZE - 8){
+                return;
+            }
+            this->sectionAt = at;
+            this->records = count;
+        }
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * PredecodedImage(string fileName)
+        * Maps the executable read-only and finds its predecoded section, if
+        * it has one.
+        * ------------------------------------------------------------------------ */
+        PredecodedImage(string fileName){
+            struct stat info;
+            int fd = open(fileName.c_str(), O_RDONLY);
+
+            this->data = nullptr;
+            this->length = 0;
+            this->sectionAt = 0;
+            this->records = 0;
+            this->owned = true;
+            if(fd < 0){
+                return;
+            }
+            if(fstat(fd, &info) == 0 && info.st_size > 0){
+                void* m = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if(m != MAP_FAILED){
+                    this->data = (const char*)m;
+                    this->length = info.st_size;
+                }
+            }
+            close(fd);
+            this->locate();
+        }
+
+       /* ------------------------------------------------------------------------
+        * PredecodedImage(const char* bytes, size_t length)
+        * An executable already in memory, length bytes at bytes. Nothing is
+        * copied, the bytes must outlive this object.
+        * ------------------------------------------------------------------------ */
+        PredecodedImage(const char* bytes, size_t length){
+            this->data = length > 0 ? bytes : nullptr;
+            this->length = length;
+            this->sectionAt = 0;
+            this->records = 0;
+            this->owned = false;
+            this->locate();
+        }
+
+        ~PredecodedImage(){
+            if(this->owned && this->data != nullptr){
+                munmap((void*)this->data, this->length);
+            }
+        }
+
+        bool hasSection(){
+            return this->sectionAt != 0;
+        }
+
+        // Bytes of the program itself, before the section
+        uint64_t programBytes(){
+            return this->hasSection() ? this->sectionAt : this->length;
+        }
+
+        uint32_t recordCount(){
+            return this->records;
+        }
+
+       /* ------------------------------------------------------------------------
+        * const PredecodedInstruction* instructions()
+        * The records, in place, one per word of code. Valid while the image
+        * exists.
+        * ------------------------------------------------------------------------ */
+        const PredecodedInstruction* instructions(){
+            return (const PredecodedInstruction*)(this->data + this->sectionAt + PREDECODED_MAGIC_SIZE + 8);
+        }
+
+       /* ------------------------------------------------------------------------
+        * static int lengthOf(int8_t opCode)
+        * Words taken by an instruction, as FetchAndDecode sees it, 0 if the
+        * code is not an instruction.
+        * ------------------------------------------------------------------------ */
+        static int lengthOf(int8_t opCode){
+            switch(opCode){
+                case 14: case 17: case 20: case 24: case 25: case 26: return 1;
+                case 4: case 5: case 7: case 10: case 11: case 12: case 13:
+                case 15: case 16: case 18: case 19: case 23: case 27: return 2;
+                case 1: case 2: case 3: case 6: case 8: case 9: case 21: case 22: return 3;
+                default: return 0;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * static string build(const string& code, uint64_t sectionAt)
+        * Returns the section and footer for a program whose code, as written
+        * after the entry word, is code, when the section is written at offset
+        * sectionAt of the file (a multiple of 8). Code is decoded from the
+        * bytes, exactly as the emulator would. Blocks start at the entry, at
+        * the targets of jumps and calls, and after jumps, calls, RET and HLT.
+        * ------------------------------------------------------------------------ */
+        static string build(const string& code, uint64_t sectionAt){
+            size_t words = code.size() / 2;
+            vector<PredecodedInstruction> records(words);
+            string section(PREDECODED_MAGIC, PREDECODED_MAGIC_SIZE);
+            uint32_t count = words;
+
+            memset(records.data(), 0, words * sizeof(PredecodedInstruction));
+            for(size_t w = 0; w < words; ){
+                int16_t word;
+                memcpy(&word, code.data() + 2 * w, sizeof(int16_t));
+                PredecodedInstruction& r = records[w];
+                r.opCode = (int8_t)(word >> 8);
+                r.operandType = (int8_t)word;
+                r.length = PredecodedImage::lengthOf(r.opCode);
+                if(r.length == 0 || w + r.length > words){
+                    memset(&r, 0, sizeof(PredecodedInstruction));
+                    w++;
+                    continue;
+                }
+                r.flags = PREDECODED_INSTRUCTION;
+                if(r.length > 1){
+                    memcpy(&r.op1, code.data() + 2 * (w + 1), sizeof(int16_t));
+                }
+                if(r.length > 2){
+                    memcpy(&r.op2, code.data() + 2 * (w + 2), sizeof(int16_t));
+                }
+                w += r.length;
+            }
+
+            // Basic block boundaries
+            bool leader = true;
+            for(size_t w = 0; w < words; w++){
+                PredecodedInstruction& r = records[w];
+                if(!(r.flags & PREDECODED_INSTRUCTION)){
+                    continue;
+                }
+                if(leader){
+                    r.flags |= PREDECODED_BLOCK_START;
+                }
+                leader = (r.opCode >= 10 && r.opCode <= 14) || r.opCode == 20;
+                if(r.opCode >= 10 && r.opCode <= 13 && r.op1 >= 0 && (size_t)r.op1 < words
+                   && (records[r.op1].flags & PREDECODED_INSTRUCTION)){
+                    records[r.op1].flags |= PREDECODED_BLOCK_START;
+                }
+            }
+
+            section.append((const char*)&count, sizeof(uint32_t));
+            section.append(4, 0);
+            section.append((const char*)records.data(), words * sizeof(PredecodedInstruction));
+            section.append((const char*)&sectionAt, sizeof(uint64_t));
+            section.append(PREDECODED_MAGIC, PREDECODED_MAGIC_SIZE);
+            return section;
+        }
+};
+
+#endif
@@ -0,0 +1,117 @@
+/* Simple86_Compiler Profile
+ *
+ * An execution profile of a Simple86 program: how many times the
+ * instruction at each address ran and, for JZ and JS, how many
+ * times the jump was taken. Written by the emulator, read back by
+ * the linker to lay out the program after what actually runs.
+ *
+ */
+
+#ifndef SIMULA_PROFILE
+#define SIMULA_PROFILE 1
+
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include <vector>
+
+// First line of a profile file, and its format
+#define PROFILE_MAGIC "S86P1"
+
+using namespace std;
+
+// Profile of a Simple86 program run
+class Profile{
+
+    private:
+        vector<uint64_t> executions; // Per address, times the instruction there ran
+        vector<uint64_t> taken; // Per address, times the jump there was taken
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * Profile(size_t size)
+        * An empty profile for a memory of size words.
+        * ------------------------------------------------------------------------ */
+        Profile(size_t size = 0){
+            this->executions.assign(size, 0);
+            this->taken.assign(size, 0);
+        }
+
+        // Counts one run of the instruction at address, and whether it jumped
+        void executed(uint16_t address, bool jumped){
+            if(address >= this->executions.size()){
+                return;
+            }
+            this->executions[address]++;
+            if(jumped){
+                this->taken[address]++;
+            }
+        }
+
+        uint64_t executionsAt(int16_t address) const{
+            return address >= 0 && (size_t)address < this->executions.size() ? this->executions[address] : 0;
+        }
+
+        uint64_t takenAt(int16_t address) const{
+            return address >= 0 && (size_t)address < this->taken.size() ? this->taken[address] : 0;
+        }
+
+        // Instructions run, over all addresses
+        uint64_t totalExecutions() const{
+            uint64_t total = 0;
+            for(uint64_t e : this->executions){
+                total += e;
+            }
+            return total;
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool write(string fileName)
+        * Writes the profile as text, the magic line, then one line per address
+        * that ran: "address executions taken".
+        * ------------------------------------------------------------------------ */
+        bool write(string fileName){
+            ofstream out(fileName.c_str());
+            if(!out.is_open()){
+                return false;
+            }
+            out << PROFILE_MAGIC << endl;
+            for(size_t a = 0; a < this->executions.size(); a++){
+                if(this->executions[a] > 0){
+                    out << a << ' ' << this->executions[a] << ' ' << this->taken[a] << endl;
+                }
+            }
+            return out.good();
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool read(string fileName)
+        * Reads a profile written by write. Returns false if the file can't be
+        * read or is not a profile.
+        * ------------------------------------------------------------------------ */
+        bool read(string fileName){
+            ifstream in(fileName.c_str());
+            string magic;
+            long address;
+            uint64_t count, jumps;
+
+            if(!(in >> magic) || magic != PROFILE_MAGIC){
+                return false;
+            }
+            while(in >> address >> count >> jumps){
+                if(address < 0 || address > INT16_MAX){
+                    return false;
+                }
+                if((size_t)address >= this->executions.size()){
+                    this->executions.resize(address + 1, 0);
+                    this->taken.resize(address + 1, 0);
+                }
+                this->executions[address] = count;
+                this->taken[address] = jumps;
+            }
+            return in.eof();
+        }
+};
+
+#endif
@@ -0,0 +1,448 @@
+/* Simple86_Compiler Program
+ *
+ * The compact representation of a program shared by the Mounter
+ * and the Linker. Instructions are kept as structure of arrays,
+ * one byte codes and int16_t operands, and every text (labels,
+ * operands as written) is interned once in an arena backed pool.
+ *
+ */
+
+#ifndef SIMULA_PROGRAM
+#define SIMULA_PROGRAM 1
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "Instruction.h"
+#include "ObjectFile.h"
+
+using namespace std;
+
+// Identifies a text interned in a SymbolPool
+typedef uint32_t SymbolId;
+
+// Means there is no text, e.g. a missing operand
+#define NO_SYMBOL 0xFFFFFFFF
+
+// Bytes of each arena block of a SymbolPool
+#define SYMBOL_BLOCK_SIZE 65536
+
+// How an operand is encoded, given by its position and the operand type
+enum OperandKind{
+    NO_OPERAND = 0,
+    REGISTER_OPERAND = 1, // A register code
+    IMMEDIATE_OPERAND = 2, // A hexa number
+    MEMORY_OPERAND = 3, // An address, written as a name until resolved
+    INDEXED_OPERAND = 4 // The displacement added to BX, a name, until resolved, or a hexa number
+};
+
+// A text inside the arena, used as key of the pool's index
+struct SymbolKey{
+    const char* text;
+    size_t length;
+
+    bool operator==(const SymbolKey& other) const{
+        return this->length == other.length && memcmp(this->text, other.text, this->length) == 0;
+    }
+};
+
+struct SymbolKeyHash{
+    size_t operator()(const SymbolKey& key) const{
+        size_t h = 14695981039346656037ULL;
+        for(size_t i = 0; i < key.length; i++){
+            h ^= (unsigned char)key.text[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+};
+
+// SymbolPool, interned texts of a Program
+class SymbolPool{
+
+    private:
+        vector<char*> blocks; // The arena
+        size_t blockUsed; // Bytes used in the last block
+        size_t blockCapacity; // Bytes of the last block
+        vector<const char*> texts; // Text of each id, inside the arena
+        vector<uint32_t> lengths; // Length of each id's text
+        unordered_map<SymbolKey, SymbolId, SymbolKeyHash> index; // Text to id
+
+       /* ------------------------------------------------------------------------
+        * char* allocate(size_t length)
+        * Reserves length bytes in the arena. Texts never move once stored.
+        * ------------------------------------------------------------------------ */
+        char* allocate(size_t length){
+            if(this->blocks.empty() || this->blockUsed + length > this->blockCapacity){
+                this->blockCapacity = max((size_t)SYMBOL_BLOCK_SIZE, length);
+                this->blocks.push_back((char*)malloc(this->blockCapacity));
+                this->blockUsed = 0;
+            }
+            char* at = this->blocks.back() + this->blockUsed;
+            this->blockUsed += length;
+            return at;
+        }
+
+    public:
+        SymbolPool(){
+            this->blockUsed = 0;
+            this->blockCapacity = 0;
+        }
+
+        SymbolPool(const SymbolPool&) = delete;
+        SymbolPool& operator=(const SymbolPool&) = delete;
+
+        ~SymbolPool(){
+            this->clear();
+        }
+
+        void clear(){
+            for(char* b : this->blocks){
+                free(b);
+            }
+            this->blocks.clear();
+            this->blockUsed = 0;
+            this->blockCapacity = 0;
+            this->texts.clear();
+            this->lengths.clear();
+            this->index.clear();
+        }
+
+       /* ------------------------------------------------------------------------
+        * SymbolId intern(const char* text, size_t length)
+        * Returns the id of the text, storing it if it was never seen.
+        * ------------------------------------------------------------------------ */
+        SymbolId intern(const char* text, size_t length){
+            SymbolKey key = { text, length };
+            unordered_map<SymbolKey, SymbolId, SymbolKeyHash>::const_iterator found = this->index.find(key);
+            if(found != this->index.end()){
+                return found->second;
+            }
+            char* stored = this->allocate(length);
+            memcpy(stored, text, length);
+            key.text = stored;
+            SymbolId id = this->texts.size();
+            this->texts.push_back(stored);
+            this->lengths.push_back(length);
+            this->index.insert(make_pair(key, id));
+            return id;
+        }
+
+        SymbolId intern(const string& text){
+            return this->intern(text.data(), text.size());
+        }
+
+       /* ------------------------------------------------------------------------
+        * SymbolId find(const string& text)
+        * Returns the id of the text, or NO_SYMBOL if it was never interned.
+        * ------------------------------------------------------------------------ */
+        SymbolId find(const string& text) const{
+            SymbolKey key = { text.data(), text.size() };
+            unordered_map<SymbolKey, SymbolId, SymbolKeyHash>::const_iterator found = this->index.find(key);
+            return found == this->index.end() ? NO_SYMBOL : found->second;
+        }
+
+        // The text of an id, empty for NO_SYMBOL
+        string str(SymbolId id) const{
+            if(id == NO_SYMBOL){
+                return string();
+            }
+            return string(this->texts[id], this->lengths[id]);
+        }
+
+        bool empty(SymbolId id) const{
+            return id == NO_SYMBOL || this->lengths[id] == 0;
+        }
+
+        size_t size() const{
+            return this->texts.size();
+        }
+};
+
+// Program, a whole program or a part of it
+class Program{
+
+    public:
+        SymbolPool symbols; // Every text used by the program
+        vector<uint8_t> type; // InstructionType
+        vector<uint8_t> code; // InstructionCode
+        vector<uint8_t> opType; // OperandType
+        vector<uint8_t> size; // The size, in bits, of each instruction
+        vector<int16_t> address; // Address, considering a word has 16 bits
+        vector<int16_t> opA, opB; // Operands, decoded by decodeOperands
+        vector<SymbolId> id; // The instruction code as written, or the label
+        vector<SymbolId> textA, textB; // The operands as written
+        vector<SymbolId> fullText; // Line read from the input, or NO_SYMBOL
+
+        Program(){
+        }
+
+        Program(const Program&) = delete;
+        Program& operator=(const Program&) = delete;
+
+        size_t count() const{
+            return this->type.size();
+        }
+
+        void clear(){
+            this->symbols.clear();
+            this->type.clear();
+            this->code.clear();
+            this->opType.clear();
+            this->size.clear();
+            this->address.clear();
+            this->opA.clear();
+            this->opB.clear();
+            this->id.clear();
+            this->textA.clear();
+            this->textB.clear();
+            this->fullText.clear();
+        }
+
+       /* ------------------------------------------------------------------------
+        * size_t add(...)
+        * Appends an instruction whose texts are already interned in this
+        * program's pool. Returns its index.
+        * ------------------------------------------------------------------------ */
+        size_t add(InstructionType type, InstructionCode code, OperandType opType, int16_t size, int16_t address,
+                   SymbolId id, SymbolId textA, SymbolId textB, SymbolId fullText){
+            this->type.push_back(type);
+            this->code.push_back(code);
+            this->opType.push_back(opType);
+            this->size.push_back(size);
+            this->address.push_back(address);
+            this->opA.push_back(0);
+            this->opB.push_back(0);
+            this->id.push_back(id);
+            this->textA.push_back(textA);
+            this->textB.push_back(textB);
+            this->fullText.push_back(fullText);
+            return this->count() - 1;
+        }
+
+       /* ------------------------------------------------------------------------
+        * size_t append(const Instruction& i)
+        * Appends an instruction decoded by the Instruction parser.
+        * ------------------------------------------------------------------------ */
+        size_t append(const Instruction& i){
+            return this->add(i.type, i.code, i.opType, i.size, i.address,
+                             this->symbols.intern(i.id), this->internOperand(i.opA.data(), i.opA.size()),
+                             this->internOperand(i.opB.data(), i.opB.size()), this->symbols.intern(i.fullText));
+        }
+
+       /* ------------------------------------------------------------------------
+        * size_t append(const ObjectRecord& r, bool keepFullText)
+        * Appends a record of an object file. The line itself is only needed to
+        * write objects, so it is skipped unless keepFullText.
+        * ------------------------------------------------------------------------ */
+        size_t append(const ObjectRecord& r, bool keepFullText = false){
+            return this->add(r.type, r.code, r.opType, r.size, r.address,
+                             this->symbols.intern(r.id.text, r.id.length), this->internOperand(r.opA.text, r.opA.length),
+                             this->internOperand(r.opB.text, r.opB.length),
+                             keepFullText ? this->symbols.intern(r.fullText.text, r.fullText.length) : NO_SYMBOL);
+        }
+
+       /* ------------------------------------------------------------------------
+        * void append(Program& other, int16_t addressOffset)
+        * Appends all of other's instructions, moved by addressOffset words.
+        * Their texts are interned again in this program's pool.
+        * ------------------------------------------------------------------------ */
+        void append(Program& other, int16_t addressOffset){
+            vector<SymbolId> remap(other.symbols.size());
+            for(SymbolId s = 0; s < remap.size(); s++){
+                remap[s] = this->symbols.intern(other.symbols.str(s));
+            }
+            for(size_t k = 0; k < other.count(); k++){
+                size_t n = this->add((InstructionType)other.type[k], (InstructionCode)other.code[k], (OperandType)other.opType[k],
+                                     other.size[k], other.address[k] + addressOffset,
+                                     Program::remapped(remap, other.id[k]), Program::remapped(remap, other.textA[k]),
+                                     Program::remapped(remap, other.textB[k]), Program::remapped(remap, other.fullText[k]));
+                this->opA[n] = other.opA[k];
+                this->opB[n] = other.opB[k];
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * void select(const vector<size_t>& entries)
+        * Keeps only the listed instructions, in the order listed. An
+        * instruction may be listed more than once, to copy it.
+        * ------------------------------------------------------------------------ */
+        void select(const vector<size_t>& entries){
+            Program::pick(this->type, entries);
+            Program::pick(this->code, entries);
+            Program::pick(this->opType, entries);
+            Program::pick(this->size, entries);
+            Program::pick(this->address, entries);
+            Program::pick(this->opA, entries);
+            Program::pick(this->opB, entries);
+            Program::pick(this->id, entries);
+            Program::pick(this->textA, entries);
+            Program::pick(this->textB, entries);
+            Program::pick(this->fullText, entries);
+        }
+
+        template<typename T>
+        static void pick(vector<T>& column, const vector<size_t>& entries){
+            vector<T> picked(entries.size());
+            for(size_t n = 0; n < entries.size(); n++){
+                picked[n] = column[entries[n]];
+            }
+            column.swap(picked);
+        }
+
+       /* ------------------------------------------------------------------------
+        * void removeMarked(const vector<char>& removed)
+        * Removes the instructions whose flag in removed is set, keeping the
+        * order of the others. Addresses are left as they were.
+        * ------------------------------------------------------------------------ */
+        void removeMarked(const vector<char>& removed){
+            size_t n = 0;
+            for(size_t k = 0; k < this->count(); k++){
+                if(removed[k]){
+                    continue;
+                }
+                this->type[n] = this->type[k];
+                this->code[n] = this->code[k];
+                this->opType[n] = this->opType[k];
+                this->size[n] = this->size[k];
+                this->address[n] = this->address[k];
+                this->opA[n] = this->opA[k];
+                this->opB[n] = this->opB[k];
+                this->id[n] = this->id[k];
+                this->textA[n] = this->textA[k];
+                this->textB[n] = this->textB[k];
+                this->fullText[n] = this->fullText[k];
+                n++;
+            }
+            this->type.resize(n);
+            this->code.resize(n);
+            this->opType.resize(n);
+            this->size.resize(n);
+            this->address.resize(n);
+            this->opA.resize(n);
+            this->opB.resize(n);
+            this->id.resize(n);
+            this->textA.resize(n);
+            this->textB.resize(n);
+            this->fullText.resize(n);
+        }
+
+        static SymbolId remapped(const vector<SymbolId>& remap, SymbolId s){
+            return s == NO_SYMBOL ? NO_SYMBOL : remap[s];
+        }
+
+        SymbolId internOperand(const char* text, size_t length){
+            return length == 0 ? NO_SYMBOL : this->symbols.intern(text, length);
+        }
+
+       /* ------------------------------------------------------------------------
+        * static OperandKind kindOfA(OperandType t), kindOfB(OperandType t)
+        * How the first and second operands of an operand type are encoded.
+        * ------------------------------------------------------------------------ */
+        static OperandKind kindOfA(OperandType t){
+            switch(t){
+                case OperandType::R:
+                case OperandType::RR:
+                case OperandType::RM:
+                case OperandType::RI:
+                case OperandType::RX: return REGISTER_OPERAND;
+                case OperandType::I: return IMMEDIATE_OPERAND;
+                case OperandType::M:
+                case OperandType::MI:
+                case OperandType::MR: return MEMORY_OPERAND;
+                case OperandType::X:
+                case OperandType::XR:
+                case OperandType::XI: return INDEXED_OPERAND;
+                default: return NO_OPERAND;
+            }
+        }
+
+        static OperandKind kindOfB(OperandType t){
+            switch(t){
+                case OperandType::RR:
+                case OperandType::MR:
+                case OperandType::XR: return REGISTER_OPERAND;
+                case OperandType::MI:
+                case OperandType::RI:
+                case OperandType::XI: return IMMEDIATE_OPERAND;
+                case OperandType::RM: return MEMORY_OPERAND;
+                case OperandType::RX: return INDEXED_OPERAND;
+                default: return NO_OPERAND;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * static int16_t operandValue(OperandKind kind, const string& text)
+        * Decodes an operand: a register code, a hexa number, or an address
+        * written as a decimal number. A memory operand still written as a
+        * name decodes as 0. A displacement is a hexa number if it starts
+        * with 0, as written, or a decimal address, once its name resolved.
+        * ------------------------------------------------------------------------ */
+        static int16_t operandValue(OperandKind kind, const string& text){
+            switch(kind){
+                case REGISTER_OPERAND: return Instruction::getRegisterCode(text);
+                case IMMEDIATE_OPERAND: return (int16_t)std::stoul(text, nullptr, 16);
+                case MEMORY_OPERAND: return Program::isName(text) ? 0 : (int16_t)stoi(text);
+                case INDEXED_OPERAND:
+                    if(Program::isName(text)){
+                        return 0;
+                    }
+                    return text.at(0) == '0' ? (int16_t)std::stoul(text, nullptr, 16) : (int16_t)stoi(text);
+                default: return 0;
+            }
+        }
+
+        // True if an operand, of the given kind and text, refers to a name:
+        // memory operands always do, displacements when written as one
+        bool refersToName(OperandKind kind, SymbolId text){
+            return kind == MEMORY_OPERAND || (kind == INDEXED_OPERAND && Program::isName(this->symbols.str(text)));
+        }
+
+        // The text of an operand as written, indexed ones inside [bx+...]
+        string operandText(SymbolId text, OperandKind kind){
+            string str = this->symbols.str(text);
+            return kind == INDEXED_OPERAND ? "[bx+" + str + "]" : str;
+        }
+
+        // Names are what the mounter classifies as memory, words starting with '_'
+        static bool isName(const string& text){
+            return !text.empty() && text.at(0) == '_';
+        }
+
+       /* ------------------------------------------------------------------------
+        * void decodeOperands(size_t k)
+        * Sets opA and opB of the k-th instruction from their texts.
+        * ------------------------------------------------------------------------ */
+        void decodeOperands(size_t k){
+            if(this->type[k] != InstructionType::INSTRUCTION){
+                return;
+            }
+            this->opA[k] = Program::operandValue(Program::kindOfA((OperandType)this->opType[k]), this->symbols.str(this->textA[k]));
+            this->opB[k] = Program::operandValue(Program::kindOfB((OperandType)this->opType[k]), this->symbols.str(this->textB[k]));
+        }
+
+       /* ------------------------------------------------------------------------
+        * string debugInstruction(size_t k)
+        * Same as Instruction::debugInstruction, for the k-th instruction.
+        * ------------------------------------------------------------------------ */
+        string debugInstruction(size_t k){
+            string str = this->symbols.str(this->id[k]);
+            if(!this->symbols.empty(this->textA[k])){
+                str += ' ' + this->operandText(this->textA[k], Program::kindOfA((OperandType)this->opType[k]));
+            }
+            if(!this->symbols.empty(this->textB[k])){
+                str += ", " + this->operandText(this->textB[k], Program::kindOfB((OperandType)this->opType[k]));
+            }
+
+            // String is in upper case
+            transform(str.begin(), str.end(), str.begin(), ::toupper);
+
+            return str;
+        }
+};
+
+#endif
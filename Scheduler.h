@@ -0,0 +1,305 @@
+/* Simple86_Emulator Scheduler
+ *
+ * Runs many Simple86 machines on one thread, cooperatively. Each
+ * machine runs for a quantum of instructions at a time; one whose
+ * READ finds no input is parked until a word is delivered to it,
+ * so only that machine waits, and WRITE posts its word to an
+ * output channel taken by another thread.
+ *
+ */
+
+#ifndef SIMULA_SCHEDULER
+#define SIMULA_SCHEDULER 1
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "Memory.h"
+#include "Execute.h"
+#include "FetchAndDecode.h"
+#include "Console.h"
+#include "Predecoded.h"
+
+using namespace std;
+
+// Something a scheduled machine did, for whoever shows its output
+struct OutputEvent{
+    uint32_t machine;
+    int16_t word; // Written by WRITE, or one of the registers of a DUMP
+    bool halted; // The machine halted, word means nothing
+};
+
+// Output of the machines of a Scheduler, posted by its thread, taken by another
+class OutputChannel{
+
+    private:
+        mutex lock;
+        condition_variable posted;
+        vector<OutputEvent> events; // Posted, not yet taken
+        bool closed;
+
+    public:
+
+        OutputChannel(){
+            this->closed = false;
+        }
+
+        void post(const OutputEvent& event){
+            {
+                unique_lock<mutex> guard(this->lock);
+                this->events.push_back(event);
+            }
+            this->posted.notify_one();
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool take(vector<OutputEvent>& taken)
+        * Waits for events and moves all of them, in the order they were posted,
+        * into taken, which is cleared first. Returns false once the channel is
+        * closed and every event was taken.
+        * ------------------------------------------------------------------------ */
+        bool take(vector<OutputEvent>& taken){
+            unique_lock<mutex> guard(this->lock);
+            this->posted.wait(guard, [this]{ return this->closed || !this->events.empty(); });
+            taken.clear();
+            taken.swap(this->events);
+            return !taken.empty();
+        }
+
+        // No more events will be posted
+        void close(){
+            {
+                unique_lock<mutex> guard(this->lock);
+                this->closed = true;
+            }
+            this->posted.notify_all();
+        }
+};
+
+// Console of a scheduled machine: reads the words delivered to it, and once
+// its input is closed, 0; writes to the output channel
+class ChannelConsole : public Console{
+
+    public:
+        uint32_t machine;
+        OutputChannel* channel;
+        deque<int16_t> input;
+        bool closed; // No more words will be delivered
+
+        bool read(int16_t& word){
+            if(this->input.empty()){
+                word = 0;
+                return this->closed;
+            }
+            word = this->input.front();
+            this->input.pop_front();
+            return true;
+        }
+
+        void write(int16_t word){
+            this->channel->post(OutputEvent{this->machine, word, false});
+        }
+
+        void dump(const int16_t registers[DUMP_REGISTERS]){
+            for(int r = 0; r < DUMP_REGISTERS; r++){
+                this->write(registers[r]);
+            }
+        }
+};
+
+// A machine known to a Scheduler
+struct ScheduledMachine{
+    Memory* memory; // Null once the machine halted
+    Execute* execute;
+    FetchAndDecode* fetchAndDecode;
+    ChannelConsole console;
+    bool waiting; // Parked at a READ
+    uint64_t executed; // Instructions run so far
+};
+
+// The Scheduler
+class Scheduler{
+
+    private:
+        vector<ScheduledMachine*> machines; // By id
+        deque<uint32_t> ready; // Machines to run, in turn
+        size_t live; // Machines not halted
+        uint64_t quantum; // Instructions a machine runs before the next one's turn
+        OutputChannel* output;
+
+        // Words and closes delivered from other threads, taken between turns
+        mutex inboxLock;
+        condition_variable mail;
+        vector< pair<uint32_t, int16_t> > inbox;
+        vector<uint32_t> closing;
+        atomic<bool> hasMail;
+
+       /* ------------------------------------------------------------------------
+        * void takeMail()
+        * Gives the delivered words to their machines, closes the inputs asked
+        * to be closed, and makes the machines waiting for them ready again.
+        * ------------------------------------------------------------------------ */
+        void takeMail(){
+            vector< pair<uint32_t, int16_t> > words;
+            vector<uint32_t> closed;
+            {
+                unique_lock<mutex> guard(this->inboxLock);
+                words.swap(this->inbox);
+                closed.swap(this->closing);
+                this->hasMail = false;
+            }
+            for(pair<uint32_t, int16_t>& w : words){
+                this->machines[w.first]->console.input.push_back(w.second);
+                this->wake(w.first);
+            }
+            for(uint32_t id : closed){
+                this->machines[id]->console.closed = true;
+                this->wake(id);
+            }
+        }
+
+        void wake(uint32_t id){
+            ScheduledMachine* m = this->machines[id];
+            if(m->waiting && m->memory != nullptr){
+                m->waiting = false;
+                this->ready.push_back(id);
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * void finish(ScheduledMachine* m)
+        * Frees the machine of a program that halted, keeping only its counts.
+        * ------------------------------------------------------------------------ */
+        void finish(ScheduledMachine* m){
+            this->output->post(OutputEvent{m->console.machine, 0, true});
+            delete m->fetchAndDecode;
+            delete m->execute;
+            delete m->memory;
+            m->fetchAndDecode = nullptr;
+            m->execute = nullptr;
+            m->memory = nullptr;
+            this->live--;
+        }
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * Scheduler(OutputChannel* output, uint64_t quantum)
+        * A scheduler posting the machines' output to output, and switching
+        * machines every quantum instructions.
+        * ------------------------------------------------------------------------ */
+        Scheduler(OutputChannel* output, uint64_t quantum = 1000){
+            this->live = 0;
+            this->quantum = quantum > 0 ? quantum : 1;
+            this->output = output;
+            this->hasMail = false;
+        }
+
+        ~Scheduler(){
+            for(ScheduledMachine* m : this->machines){
+                delete m->fetchAndDecode;
+                delete m->execute;
+                delete m->memory;
+                delete m;
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * uint32_t add(Memory* memory, const PredecodedInstruction* records, int32_t count)
+        * Schedules a machine on a loaded memory, which the scheduler takes and
+        * deletes, running the count first words from records if there are
+        * any. Returns the machine's id, ids are given in order from 0. Must
+        * be called from the scheduler's thread.
+        * ------------------------------------------------------------------------ */
+        uint32_t add(Memory* memory, const PredecodedInstruction* records = nullptr, int32_t count = 0){
+            ScheduledMachine* m = new ScheduledMachine();
+            uint32_t id = this->machines.size();
+
+            m->memory = memory;
+            m->console.machine = id;
+            m->console.channel = this->output;
+            m->console.closed = false;
+            m->execute = new Execute(memory, &m->console);
+            m->fetchAndDecode = new FetchAndDecode(memory, m->execute);
+            if(records != nullptr){
+                m->fetchAndDecode->usePredecoded(records, count);
+            }
+            m->waiting = false;
+            m->executed = 0;
+            this->machines.push_back(m);
+            this->ready.push_back(id);
+            this->live++;
+            return id;
+        }
+
+        // Delivers an input word to a machine. Safe to call from any thread.
+        void deliver(uint32_t id, int16_t word){
+            {
+                unique_lock<mutex> guard(this->inboxLock);
+                this->inbox.push_back(make_pair(id, word));
+                this->hasMail = true;
+            }
+            this->mail.notify_one();
+        }
+
+        // Closes the input of a machine, its READs read 0 from then on once
+        // the words delivered run out. Safe to call from any thread.
+        void closeInput(uint32_t id){
+            {
+                unique_lock<mutex> guard(this->inboxLock);
+                this->closing.push_back(id);
+                this->hasMail = true;
+            }
+            this->mail.notify_one();
+        }
+
+        // Machines that did not halt yet
+        size_t liveCount(){
+            return this->live;
+        }
+
+        size_t machineCount(){
+            return this->machines.size();
+        }
+
+        uint64_t executedBy(uint32_t id){
+            return this->machines[id]->executed;
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool runUntilIdle()
+        * Runs the ready machines in turn until every machine halted or waits
+        * for input. Returns true if some machine did not halt.
+        * ------------------------------------------------------------------------ */
+        bool runUntilIdle(){
+            while(true){
+                if(this->hasMail){
+                    this->takeMail();
+                }
+                if(this->ready.empty()){
+                    return this->live > 0;
+                }
+                ScheduledMachine* m = this->machines[this->ready.front()];
+                this->ready.pop_front();
+                m->executed += m->fetchAndDecode->run(this->quantum);
+                if(m->fetchAndDecode->halted()){
+                    this->finish(m);
+                }else if(m->fetchAndDecode->waitingForInput()){
+                    m->waiting = true;
+                }else{
+                    this->ready.push_back(m->console.machine);
+                }
+            }
+        }
+
+        // Blocks until some word or close is delivered
+        void waitForMail(){
+            unique_lock<mutex> guard(this->inboxLock);
+            this->mail.wait(guard, [this]{ return this->hasMail.load(); });
+        }
+};
+
+#endif
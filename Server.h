@@ -0,0 +1,298 @@
+/* Simple86_Server Server
+ *
+ * A long-lived emulator: answers run requests (see ServerProtocol.h)
+ * on a Unix domain socket, or on its standard input and output, so
+ * a program is not started and loaded once per run. Executables are
+ * decoded once and kept, predecoded, in an LRU cache keyed by the
+ * hash of their bytes; runs are time sliced over a pool of workers
+ * by a BatchScheduler, so long runs don't hold back short ones.
+ *
+ */
+
+#ifndef SIMULA_SERVER
+#define SIMULA_SERVER 1
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Memory.h"
+#include "Execute.h"
+#include "FetchAndDecode.h"
+#include "Console.h"
+#include "Predecoded.h"
+#include "BuildCache.h"
+#include "BatchScheduler.h"
+#include "ServerProtocol.h"
+
+using namespace std;
+
+// An executable as the server keeps it, decoded and ready to be loaded
+struct ServerImage{
+    Memory loaded; // The program from address 0, registers at 0 and IP at its entry
+    size_t words; // Words of the program
+    string section; // Its predecoded section, see PredecodedImage::build
+
+    const PredecodedInstruction* instructions() const{
+        return (const PredecodedInstruction*)(this->section.data() + PREDECODED_MAGIC_SIZE + 8);
+    }
+};
+
+// The emulator server
+class Server{
+
+    private:
+        BatchScheduler* scheduler; // Runs the requests
+        size_t capacity; // Images kept in the cache
+        uint64_t maxBudget; // Instructions a request may run at most
+        mutex cacheLock; // Guards recent and images
+        list< pair<uint64_t, shared_ptr<const ServerImage> > > recent; // Most recently used first
+        unordered_map<uint64_t, list< pair<uint64_t, shared_ptr<const ServerImage> > >::iterator> images; // By id
+
+        // A client being served, its replies are written whole, one at a time
+        struct Connection{
+            int input, output;
+            mutex writeLock;
+            mutex pendingLock;
+            condition_variable idle;
+            size_t pending; // Requests running
+        };
+
+       /* ------------------------------------------------------------------------
+        * shared_ptr<const ServerImage> findImage(uint64_t id)
+        * The cached image with the given id, marked as the most recently used,
+        * or null.
+        * ------------------------------------------------------------------------ */
+        shared_ptr<const ServerImage> findImage(uint64_t id){
+            unique_lock<mutex> guard(this->cacheLock);
+            auto found = this->images.find(id);
+            if(found == this->images.end()){
+                return nullptr;
+            }
+            this->recent.splice(this->recent.begin(), this->recent, found->second);
+            return found->second->second;
+        }
+
+       /* ------------------------------------------------------------------------
+        * shared_ptr<const ServerImage> addImage(const string& bytes, uint64_t& id)
+        * Decodes an executable, as the linker writes it, and caches it under
+        * the hash of its bytes, given back in id. The least recently used
+        * image is dropped if the cache is full; runs using it finish first.
+        * Returns null if the bytes are not an executable.
+        * ------------------------------------------------------------------------ */
+        shared_ptr<const ServerImage> addImage(const string& bytes, uint64_t& id){
+            id = BuildCache::hash(bytes.data(), bytes.size());
+            shared_ptr<const ServerImage> cached = this->findImage(id);
+            if(cached != nullptr){
+                return cached;
+            }
+
+            PredecodedImage file(bytes.data(), bytes.size());
+            uint64_t programBytes = file.programBytes();
+            if(programBytes < 2 || programBytes > bytes.size()){
+                return nullptr;
+            }
+            ServerImage* image = new ServerImage();
+            size_t words = programBytes / 2 - 1 < MEMORY_LIMIT ? programBytes / 2 - 1 : MEMORY_LIMIT;
+            int16_t word;
+            for(size_t i = 0; i < words; i++){
+                memcpy(&word, bytes.data() + 2 + 2 * i, sizeof(int16_t));
+                image->loaded.writeMemory((int16_t)i, word);
+            }
+            memcpy(&word, bytes.data(), sizeof(int16_t));
+            image->loaded.setRegister(Memory::IP, word);
+            image->words = words;
+            image->section = PredecodedImage::build(bytes.substr(2, words * sizeof(int16_t)), 0);
+            shared_ptr<const ServerImage> added(image);
+
+            unique_lock<mutex> guard(this->cacheLock);
+            if(this->images.count(id) == 0){
+                this->recent.push_front(make_pair(id, added));
+                this->images[id] = this->recent.begin();
+                while(this->recent.size() > this->capacity){
+                    this->images.erase(this->recent.back().first);
+                    this->recent.pop_back();
+                }
+            }
+            return added;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void serveConnection(Connection* client)
+        * Reads the requests of a client until it closes its end, starting each
+        * on the scheduler and writing its reply as soon as it is ready.
+        * Returns once every reply was written.
+        * ------------------------------------------------------------------------ */
+        void serveConnection(Connection* client){
+            string frame;
+            while(ServerProtocol::readFrame(client->input, frame)){
+                ServerRequest request;
+                request.tag = 0;
+                {
+                    unique_lock<mutex> guard(client->pendingLock);
+                    client->pending++;
+                }
+                function<void(const ServerReply&)> done = [client](const ServerReply& reply){
+                    {
+                        unique_lock<mutex> guard(client->writeLock);
+                        ServerProtocol::writeFrame(client->output, ServerProtocol::encode(reply));
+                    }
+                    unique_lock<mutex> guard(client->pendingLock);
+                    if(--client->pending == 0){
+                        client->idle.notify_all();
+                    }
+                };
+                if(ServerProtocol::decode(frame, request)){
+                    this->start(request, done);
+                }else{
+                    done(Server::replyTo(request, SERVER_BAD_REQUEST));
+                }
+            }
+            unique_lock<mutex> guard(client->pendingLock);
+            client->idle.wait(guard, [client]{ return client->pending == 0; });
+        }
+
+        // A reply to request with the given status, nothing run
+        static ServerReply replyTo(const ServerRequest& request, uint8_t status){
+            ServerReply reply;
+            reply.status = status;
+            reply.tag = request.tag;
+            reply.imageId = status == SERVER_BAD_REQUEST ? 0 : request.imageId;
+            reply.executed = 0;
+            memset(reply.registers, 0, sizeof(reply.registers));
+            return reply;
+        }
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * Server(unsigned int workers, size_t capacity, uint64_t maxBudget, uint64_t slice)
+        * A server running requests on workers threads (0 means one per
+        * hardware thread), in turns of slice instructions, caching capacity
+        * images, and stopping any run after maxBudget instructions (0 means
+        * never).
+        * ------------------------------------------------------------------------ */
+        Server(unsigned int workers, size_t capacity, uint64_t maxBudget, uint64_t slice = 10000){
+            this->scheduler = new BatchScheduler(workers, slice);
+            this->capacity = capacity > 0 ? capacity : 1;
+            this->maxBudget = maxBudget;
+        }
+
+        ~Server(){
+            delete this->scheduler;
+        }
+
+       /* ------------------------------------------------------------------------
+        * void start(const ServerRequest& request, function<void(const ServerReply&)> done)
+        * Starts one request on a fresh machine: memory and registers start at
+        * 0, the image is loaded, sharing the cached one's pages copy-on-write,
+        * READ takes the request's input words and reads
+        * 0 once they run out, and WRITE and DUMP fill the reply's output words.
+        * The reply is given to done, on a worker, or right away if the request
+        * can't be run. Safe to call from many threads at once.
+        * ------------------------------------------------------------------------ */
+        void start(const ServerRequest& request, function<void(const ServerReply&)> done){
+            shared_ptr<const ServerImage> image;
+            uint64_t id = request.imageId;
+
+            if(request.kind == SERVER_RUN_IMAGE){
+                image = this->addImage(request.image, id);
+                if(image == nullptr){
+                    done(Server::replyTo(request, SERVER_BAD_REQUEST));
+                    return;
+                }
+            }else{
+                image = this->findImage(request.imageId);
+                if(image == nullptr){
+                    done(Server::replyTo(request, SERVER_UNKNOWN_IMAGE));
+                    return;
+                }
+            }
+
+            Memory* memory = new Memory(image->loaded);
+
+            BatchJob* job = new BatchJob(memory, image->instructions(), image->words);
+            job->console.input.assign(request.input.begin(), request.input.end());
+            job->priority = request.priority < BATCH_PRIORITIES ? request.priority : BATCH_PRIORITIES - 1;
+            job->budget = request.budget;
+            if(this->maxBudget != 0 && (job->budget == 0 || job->budget > this->maxBudget)){
+                job->budget = this->maxBudget;
+            }
+
+            // The image stays alive, even if dropped from the cache, until the job ends
+            ServerReply reply = Server::replyTo(request, SERVER_HALTED);
+            reply.imageId = id;
+            job->done = [image, reply, done](BatchJob* job) mutable{
+                Memory::Register order[SERVER_REGISTERS] = { Memory::AX, Memory::BX, Memory::CX, Memory::SP, Memory::BP, Memory::IP, Memory::ZF, Memory::SF };
+                for(int r = 0; r < SERVER_REGISTERS; r++){
+                    reply.registers[r] = job->memory->getRegister(order[r]);
+                }
+                reply.status = job->fetchAndDecode->halted() ? SERVER_HALTED : SERVER_OUT_OF_BUDGET;
+                reply.executed = job->executed;
+                reply.output.swap(job->console.output);
+                done(reply);
+            };
+            this->scheduler->submit(job);
+        }
+
+       /* ------------------------------------------------------------------------
+        * void serveStreams(int input, int output)
+        * Serves a single client speaking on the given file descriptors, as
+        * the standard input and output, until it closes input.
+        * ------------------------------------------------------------------------ */
+        void serveStreams(int input, int output){
+            Connection client;
+            client.input = input;
+            client.output = output;
+            client.pending = 0;
+            this->serveConnection(&client);
+        }
+
+       /* ------------------------------------------------------------------------
+        * bool serveSocket(string path)
+        * Listens on a Unix domain socket at path, replacing any file there,
+        * and serves each client that connects on a thread of its own. Returns
+        * false, only, if the socket could not be set up.
+        * ------------------------------------------------------------------------ */
+        bool serveSocket(string path){
+            struct sockaddr_un address;
+            int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+            if(listener < 0 || path.size() >= sizeof(address.sun_path)){
+                return false;
+            }
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            strcpy(address.sun_path, path.c_str());
+            unlink(path.c_str());
+            if(bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 128) != 0){
+                ::close(listener);
+                return false;
+            }
+
+            while(true){
+                int fd = accept(listener, nullptr, nullptr);
+                if(fd < 0){
+                    continue;
+                }
+                // Readers wait on their clients, so they don't take workers
+                thread([this, fd]{
+                    this->serveStreams(fd, fd);
+                    ::close(fd);
+                }).detach();
+            }
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,224 @@
+/* Simple86_Server Protocol
+ *
+ * The frames the emulator server and its clients exchange over a
+ * Unix domain socket or a pair of pipes. A client sends run
+ * requests, each naming an image by the hash of its bytes or
+ * carrying the bytes, and gets back one reply per request. Every
+ * frame carries a tag chosen by the client, replies to requests
+ * sent on the same connection may come back in any order.
+ *
+ */
+
+#ifndef SIMULA_SERVERPROTOCOL
+#define SIMULA_SERVERPROTOCOL 1
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <cerrno>
+#include <unistd.h>
+
+using namespace std;
+
+// Largest frame accepted, in bytes, an executable is far smaller
+#define SERVER_MAX_FRAME (1 << 20)
+
+// Kinds of request
+#define SERVER_RUN_ID 1 // Runs the image cached under imageId
+#define SERVER_RUN_IMAGE 2 // Runs the image sent after the input words
+
+// Status of a reply
+#define SERVER_HALTED 0 // The program halted
+#define SERVER_OUT_OF_BUDGET 1 // The program ran all the instructions it was given
+#define SERVER_UNKNOWN_IMAGE 2 // No image is cached under imageId, send the bytes
+#define SERVER_BAD_REQUEST 3 // The frame could not be understood
+
+// Registers in a reply, in DUMP order: AX BX CX SP BP IP ZF SF
+#define SERVER_REGISTERS 8
+
+// Layout of the frames, numbers are little endian, each frame starts with
+// a uint32 telling the bytes that follow it:
+//   request: uint8 kind, 3 bytes 0, uint32 tag, uint32 inputCount, uint32 priority,
+//            uint64 budget, uint64 imageId, inputCount int16 input words,
+//            then, for SERVER_RUN_IMAGE, the bytes of the executable
+//   reply:   uint8 status, 3 bytes 0, uint32 tag, uint32 outputCount, uint32 0,
+//            uint64 imageId, uint64 instructions executed,
+//            SERVER_REGISTERS int16 registers, outputCount int16 output words
+#define SERVER_REQUEST_HEADER 32
+#define SERVER_REPLY_HEADER 48
+
+// A run request
+struct ServerRequest{
+    uint8_t kind;
+    uint32_t tag;
+    uint32_t priority; // 0 is the most urgent, see BATCH_PRIORITIES
+    uint64_t budget; // Instructions the program may run, 0 for the server's limit
+    uint64_t imageId; // BuildCache::hash of the executable
+    vector<int16_t> input; // Words READ takes, in order, then 0s
+    string image; // The executable, for SERVER_RUN_IMAGE
+};
+
+// The result of a run request
+struct ServerReply{
+    uint8_t status;
+    uint32_t tag;
+    uint64_t imageId;
+    uint64_t executed;
+    int16_t registers[SERVER_REGISTERS];
+    vector<int16_t> output; // Words written by WRITE, and 8 registers per DUMP
+};
+
+// Reading and writing of the frames
+class ServerProtocol{
+
+    private:
+        static void put(string& out, const void* value, size_t size){
+            out.append((const char*)value, size);
+        }
+
+        static void get(const string& in, size_t offset, void* value, size_t size){
+            memcpy(value, in.data() + offset, size);
+        }
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * static bool readFully(int fd, char* buffer, size_t size)
+        * Reads exactly size bytes. Returns false at the end of the stream or
+        * on an error.
+        * ------------------------------------------------------------------------ */
+        static bool readFully(int fd, char* buffer, size_t size){
+            while(size > 0){
+                ssize_t n = ::read(fd, buffer, size);
+                if(n < 0 && errno == EINTR){
+                    continue;
+                }
+                if(n <= 0){
+                    return false;
+                }
+                buffer += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        static bool writeFully(int fd, const char* buffer, size_t size){
+            while(size > 0){
+                ssize_t n = ::write(fd, buffer, size);
+                if(n < 0 && errno == EINTR){
+                    continue;
+                }
+                if(n <= 0){
+                    return false;
+                }
+                buffer += n;
+                size -= n;
+            }
+            return true;
+        }
+
+       /* ------------------------------------------------------------------------
+        * static bool readFrame(int fd, string& frame)
+        * Reads the next frame into frame, without its size. Returns false at
+        * the end of the stream, on an error, or if the frame is too large.
+        * ------------------------------------------------------------------------ */
+        static bool readFrame(int fd, string& frame){
+            uint32_t size;
+            if(!ServerProtocol::readFully(fd, (char*)&size, sizeof(uint32_t)) || size > SERVER_MAX_FRAME){
+                return false;
+            }
+            frame.resize(size);
+            return size == 0 || ServerProtocol::readFully(fd, &frame[0], size);
+        }
+
+        // Writes frame, preceded by its size
+        static bool writeFrame(int fd, const string& frame){
+            string out;
+            uint32_t size = frame.size();
+            out.reserve(sizeof(uint32_t) + frame.size());
+            ServerProtocol::put(out, &size, sizeof(uint32_t));
+            out += frame;
+            return ServerProtocol::writeFully(fd, out.data(), out.size());
+        }
+
+        static string encode(const ServerRequest& request){
+            string out;
+            uint32_t count = request.input.size();
+            ServerProtocol::put(out, &request.kind, 1);
+            out.append(3, 0);
+            ServerProtocol::put(out, &request.tag, sizeof(uint32_t));
+            ServerProtocol::put(out, &count, sizeof(uint32_t));
+            ServerProtocol::put(out, &request.priority, sizeof(uint32_t));
+            ServerProtocol::put(out, &request.budget, sizeof(uint64_t));
+            ServerProtocol::put(out, &request.imageId, sizeof(uint64_t));
+            ServerProtocol::put(out, request.input.data(), count * sizeof(int16_t));
+            if(request.kind == SERVER_RUN_IMAGE){
+                out += request.image;
+            }
+            return out;
+        }
+
+       /* ------------------------------------------------------------------------
+        * static bool decode(const string& frame, ServerRequest& request)
+        * Fills request from a frame. Returns false if the frame is not a
+        * request; the tag is filled whenever the frame holds one.
+        * ------------------------------------------------------------------------ */
+        static bool decode(const string& frame, ServerRequest& request){
+            uint32_t count;
+            if(frame.size() < SERVER_REQUEST_HEADER){
+                return false;
+            }
+            ServerProtocol::get(frame, 0, &request.kind, 1);
+            ServerProtocol::get(frame, 4, &request.tag, sizeof(uint32_t));
+            ServerProtocol::get(frame, 8, &count, sizeof(uint32_t));
+            ServerProtocol::get(frame, 12, &request.priority, sizeof(uint32_t));
+            ServerProtocol::get(frame, 16, &request.budget, sizeof(uint64_t));
+            ServerProtocol::get(frame, 24, &request.imageId, sizeof(uint64_t));
+            if((request.kind != SERVER_RUN_ID && request.kind != SERVER_RUN_IMAGE)
+               || count > (frame.size() - SERVER_REQUEST_HEADER) / sizeof(int16_t)){
+                return false;
+            }
+            request.input.resize(count);
+            ServerProtocol::get(frame, SERVER_REQUEST_HEADER, request.input.data(), count * sizeof(int16_t));
+            size_t imageAt = SERVER_REQUEST_HEADER + count * sizeof(int16_t);
+            request.image = request.kind == SERVER_RUN_IMAGE ? frame.substr(imageAt) : string();
+            return true;
+        }
+
+        static string encode(const ServerReply& reply){
+            string out;
+            uint32_t count = reply.output.size(), zero = 0;
+            ServerProtocol::put(out, &reply.status, 1);
+            out.append(3, 0);
+            ServerProtocol::put(out, &reply.tag, sizeof(uint32_t));
+            ServerProtocol::put(out, &count, sizeof(uint32_t));
+            ServerProtocol::put(out, &zero, sizeof(uint32_t));
+            ServerProtocol::put(out, &reply.imageId, sizeof(uint64_t));
+            ServerProtocol::put(out, &reply.executed, sizeof(uint64_t));
+            ServerProtocol::put(out, reply.registers, SERVER_REGISTERS * sizeof(int16_t));
+            ServerProtocol::put(out, reply.output.data(), count * sizeof(int16_t));
+            return out;
+        }
+
+        static bool decode(const string& frame, ServerReply& reply){
+            uint32_t count;
+            if(frame.size() < SERVER_REPLY_HEADER){
+                return false;
+            }
+            ServerProtocol::get(frame, 0, &reply.status, 1);
+            ServerProtocol::get(frame, 4, &reply.tag, sizeof(uint32_t));
+            ServerProtocol::get(frame, 8, &count, sizeof(uint32_t));
+            ServerProtocol::get(frame, 16, &reply.imageId, sizeof(uint64_t));
+            ServerProtocol::get(frame, 24, &reply.executed, sizeof(uint64_t));
+            ServerProtocol::get(frame, 32, reply.registers, SERVER_REGISTERS * sizeof(int16_t));
+            if(count != (frame.size() - SERVER_REPLY_HEADER) / sizeof(int16_t)){
+                return false;
+            }
+            reply.output.resize(count);
+            ServerProtocol::get(frame, SERVER_REPLY_HEADER, reply.output.data(), count * sizeof(int16_t));
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,82 @@
+/* Simple86_Emulator SpscRing
+*
+* A bounded lock-free queue between exactly one producer thread
+* and one consumer thread. Each side owns one index; they only
+* meet through acquire/release atomics, never through a lock.
+*
+*/
+#ifndef SIMULA_SPSCRING
+#define SIMULA_SPSCRING 1
+
+#include<cstddef>
+#include<vector>
+#include<atomic>
+
+using namespace std;
+
+// Bytes of a cache line, the indexes are padded apart so each side
+// writes to a line of its own.
+#define SPSC_LINE 64
+
+// SpscRing of values of type T
+template<typename T>
+class SpscRing {
+private:
+    vector<T> slots;
+    size_t mask; // slots.size() - 1, a power of two minus one
+    char padHead[SPSC_LINE];
+    atomic<size_t> head; // Next slot to pop, written by the consumer only
+    char padTail[SPSC_LINE];
+    atomic<size_t> tail; // Next slot to push, written by the producer only
+    char padEnd[SPSC_LINE];
+
+public:
+    // A ring holding at least capacity values.
+    SpscRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        this->slots.resize(size);
+        this->mask = size - 1;
+        this->head = 0;
+        this->tail = 0;
+    }
+
+    /* ------------------------------------------------------------------------
+    * bool tryPush(const T& value)
+    * Producer side. Adds value at the end, unless the ring is full, in
+    * which case returns false and nothing changes.
+    * ------------------------------------------------------------------------ */
+    bool tryPush(const T& value) {
+        size_t t = this->tail.load(memory_order_relaxed);
+        if (t - this->head.load(memory_order_acquire) == this->slots.size()) {
+            return false;
+        }
+        this->slots[t & this->mask] = value;
+        this->tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    /* ------------------------------------------------------------------------
+    * bool tryPop(T& value)
+    * Consumer side. Takes the value at the front into value, unless the
+    * ring is empty, in which case returns false.
+    * ------------------------------------------------------------------------ */
+    bool tryPop(T& value) {
+        size_t h = this->head.load(memory_order_relaxed);
+        if (h == this->tail.load(memory_order_acquire)) {
+            return false;
+        }
+        value = this->slots[h & this->mask];
+        this->head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    // Whether the ring holds nothing, as seen from either side.
+    bool empty() {
+        return this->head.load(memory_order_acquire) == this->tail.load(memory_order_acquire);
+    }
+};
+
+#endif
@@ -0,0 +1,176 @@
+/* Simple86_Compiler ThreadPool
+ *
+ * A fixed set of worker threads shared by the compiler tools
+ * to run independent pieces of work (modules, chunks of a
+ * program) concurrently.
+ *
+ */
+
+#ifndef SIMULA_THREADPOOL
+#define SIMULA_THREADPOOL 1
+
+#include <cstddef>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+using namespace std;
+
+// ThreadPool for the Simple86 tools
+class ThreadPool{
+
+    private:
+        vector<thread> workers; // The worker threads
+        queue< function<void()> > tasks; // Work waiting for a free worker
+        mutex lock; // Guards tasks, pending and stopping
+        condition_variable hasWork; // Signaled when a task is queued or the pool stops
+        condition_variable allDone; // Signaled when pending reaches zero
+        size_t pending; // Tasks queued or running
+        bool stopping; // Set by the destructor
+
+       /* ------------------------------------------------------------------------
+        * void workerLoop()
+        * Body of each worker thread. Takes tasks from the queue until the pool
+        * is destroyed.
+        * ------------------------------------------------------------------------ */
+        void workerLoop(){
+            while(true){
+                function<void()> task;
+                {
+                    unique_lock<mutex> guard(this->lock);
+                    this->hasWork.wait(guard, [this]{ return this->stopping || !this->tasks.empty(); });
+                    if(this->tasks.empty()){
+                        return;
+                    }
+                    task = move(this->tasks.front());
+                    this->tasks.pop();
+                }
+                task();
+                {
+                    unique_lock<mutex> guard(this->lock);
+                    if(--this->pending == 0){
+                        this->allDone.notify_all();
+                    }
+                }
+            }
+        }
+
+    public:
+
+       /* ------------------------------------------------------------------------
+        * ThreadPool(unsigned int size)
+        * Starts size worker threads. A size of 0 means one thread per hardware
+        * thread available.
+        * ------------------------------------------------------------------------ */
+        ThreadPool(unsigned int size){
+            this->pending = 0;
+            this->stopping = false;
+            if(size == 0){
+                size = ThreadPool::defaultSize();
+            }
+            for(unsigned int i = 0; i < size; i++){
+                this->workers.push_back(thread(&ThreadPool::workerLoop, this));
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * ~ThreadPool()
+        * Finishes the queued work and joins every worker.
+        * ------------------------------------------------------------------------ */
+        ~ThreadPool(){
+            {
+                unique_lock<mutex> guard(this->lock);
+                this->stopping = true;
+            }
+            this->hasWork.notify_all();
+            for(thread& t : this->workers){
+                t.join();
+            }
+        }
+
+       /* ------------------------------------------------------------------------
+        * static unsigned int defaultSize()
+        * Number of hardware threads, or 1 if it can't be determined.
+        * ------------------------------------------------------------------------ */
+        static unsigned int defaultSize(){
+            unsigned int n = thread::hardware_concurrency();
+            return n == 0 ? 1 : n;
+        }
+
+       /* ------------------------------------------------------------------------
+        * unsigned int size()
+        * Number of worker threads.
+        * ------------------------------------------------------------------------ */
+        unsigned int size(){
+            return this->workers.size();
+        }
+
+       /* ------------------------------------------------------------------------
+        * void submit(function<void()> task)
+        * Queues a task to be run by some worker.
+        * ------------------------------------------------------------------------ */
+        void submit(function<void()> task){
+            {
+                unique_lock<mutex> guard(this->lock);
+                this->tasks.push(move(task));
+                this->pending++;
+            }
+            this->hasWork.notify_one();
+        }
+
+       /* ------------------------------------------------------------------------
+        * void wait()
+        * Blocks until every submitted task has finished. Must not be called
+        * from inside a task.
+        * ------------------------------------------------------------------------ */
+        void wait(){
+            unique_lock<mutex> guard(this->lock);
+            this->allDone.wait(guard, [this]{ return this->pending == 0; });
+        }
+
+       /* ------------------------------------------------------------------------
+        * void parallelFor(size_t count, function<void(size_t, size_t)> body)
+        * Splits the range [0, count) into one contiguous slice per worker and
+        * calls body(begin, end) for each slice, returning when all are done.
+        * Small ranges, or a single worker, run on the calling thread. If some
+        * slices throw, the exception of the earliest of them is rethrown here.
+        * ------------------------------------------------------------------------ */
+        void parallelFor(size_t count, function<void(size_t, size_t)> body){
+            size_t slices = this->workers.size();
+            if(slices <= 1 || count < 2){
+                body(0, count);
+                return;
+            }
+            if(slices > count){
+                slices = count;
+            }
+            vector<exception_ptr> failures(slices);
+            size_t step = count / slices;
+            size_t extra = count % slices;
+            size_t begin = 0;
+            for(size_t s = 0; s < slices; s++){
+                size_t end = begin + step + (s < extra ? 1 : 0);
+                exception_ptr* failure = &failures[s];
+                this->submit([&body, failure, begin, end]{
+                    try{
+                        body(begin, end);
+                    }catch(...){
+                        *failure = current_exception();
+                    }
+                });
+                begin = end;
+            }
+            this->wait();
+            for(exception_ptr& failure : failures){
+                if(failure){
+                    rethrow_exception(failure);
+                }
+            }
+        }
+};
+
+#endif
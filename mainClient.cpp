@@ -0,0 +1,230 @@
+/* Simple86_Client main
+ *
+ * Entry point for the client of the emulator server, and its load test:
+ * Simple86_Client --socket PATH [--budget N] [--priority P] program.bin
+ *     runs program.bin on the server, with the hexadecimal words read from
+ *     the standard input as its input, and prints its output words.
+ * Simple86_Client --socket PATH --load REQUESTS [-c CONNECTIONS] [--pipeline DEPTH] program.bin
+ *     sends REQUESTS runs of program.bin over CONNECTIONS connections, with
+ *     up to DEPTH in flight on each, and prints the throughput and latencies.
+ *
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "ServerProtocol.h"
+#include "BuildCache.h"
+
+using namespace std;
+
+// Output messages in case of error.
+class MainMessages{
+    public:
+        const static string badInput;
+        const static string badIO;
+        const static string badServer;
+};
+
+const string MainMessages::badInput = "Usage: Simple86_Client --socket PATH [--budget N] [--priority P] [--load REQUESTS [-c CONNECTIONS] [--pipeline DEPTH]] program.bin";
+const string MainMessages::badIO = "Could not open or create files. An error has occurred while performing required IO operations.";
+const string MainMessages::badServer = "Could not talk to the server.";
+
+/* ------------------------------------------------------------------------
+* int connectTo(string path)
+* Connects to the server's socket. Returns the descriptor, or -1.
+* ------------------------------------------------------------------------ */
+int connectTo(string path){
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(fd < 0 || path.size() >= sizeof(address.sun_path)){
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    if(connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* ------------------------------------------------------------------------
+* bool call(int fd, ServerRequest& request, ServerReply& reply)
+* Sends a request and waits for its reply. A request naming an image the
+* server doesn't have is sent again with the image's bytes.
+* ------------------------------------------------------------------------ */
+bool call(int fd, ServerRequest& request, ServerReply& reply){
+    string frame;
+    if(!ServerProtocol::writeFrame(fd, ServerProtocol::encode(request)) || !ServerProtocol::readFrame(fd, frame)
+       || !ServerProtocol::decode(frame, reply)){
+        return false;
+    }
+    if(reply.status == SERVER_UNKNOWN_IMAGE && request.kind == SERVER_RUN_ID){
+        request.kind = SERVER_RUN_IMAGE;
+        return call(fd, request, reply);
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------
+* bool loadConnection(string path, ServerRequest request, size_t count, size_t depth,
+*                     vector<double>& latencies)
+* Sends count copies of request on a connection of its own, keeping up to
+* depth of them in flight, and appends the latency of each, in
+* microseconds, to latencies.
+* ------------------------------------------------------------------------ */
+bool loadConnection(string path, ServerRequest request, size_t count, size_t depth, vector<double>& latencies){
+    int fd = connectTo(path);
+    vector<chrono::steady_clock::time_point> sentAt(count);
+    size_t sent = 0, received = 0;
+    string frame;
+    ServerReply reply;
+
+    if(fd < 0){
+        return false;
+    }
+    while(received < count){
+        while(sent < count && sent - received < depth){
+            request.tag = sent;
+            sentAt[sent] = chrono::steady_clock::now();
+            if(!ServerProtocol::writeFrame(fd, ServerProtocol::encode(request))){
+                close(fd);
+                return false;
+            }
+            sent++;
+        }
+        if(!ServerProtocol::readFrame(fd, frame) || !ServerProtocol::decode(frame, reply) || reply.tag >= count
+           || (reply.status != SERVER_HALTED && reply.status != SERVER_OUT_OF_BUDGET)){
+            close(fd);
+            return false;
+        }
+        latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - sentAt[reply.tag]).count());
+        received++;
+    }
+    close(fd);
+    return true;
+}
+
+/* ------------------------------------------------------------------------
+* int main(int argc, char* argv[])
+* Reads the options and runs the program once, printing its output words
+* in hexadecimal, one per line, and how it stopped on cerr, or runs the
+* load test.
+* ------------------------------------------------------------------------ */
+int main(int argc, char* argv[]){
+    string socketPath, programName;
+    size_t requests = 0, connections = 1, depth = 1;
+    ServerRequest request;
+    ServerReply reply;
+
+    request.budget = 0;
+    request.priority = 0;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--socket") == 0 && i + 1 < argc){
+            socketPath = argv[++i];
+        }else if(strcmp(argv[i], "--budget") == 0 && i + 1 < argc){
+            request.budget = strtoull(argv[++i], nullptr, 10);
+        }else if(strcmp(argv[i], "--priority") == 0 && i + 1 < argc){
+            request.priority = (uint32_t)atoi(argv[++i]);
+        }else if(strcmp(argv[i], "--load") == 0 && i + 1 < argc){
+            requests = (size_t)atol(argv[++i]);
+        }else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            connections = (size_t)atol(argv[++i]);
+        }else if(strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc){
+            depth = (size_t)atol(argv[++i]);
+        }else if(programName.empty()){
+            programName = argv[i];
+        }else{
+            cerr << MainMessages::badInput << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(socketPath.empty() || programName.empty() || connections == 0 || depth == 0){
+        cerr << MainMessages::badInput << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    ifstream program(programName.c_str(), ios::in|ios::binary);
+    ostringstream bytes;
+    if(!program.is_open()){
+        cerr << MainMessages::badIO << endl;
+        exit(EXIT_FAILURE);
+    }
+    bytes << program.rdbuf();
+    request.image = bytes.str();
+    request.imageId = BuildCache::hash(request.image.data(), request.image.size());
+    request.kind = SERVER_RUN_ID;
+    request.tag = 0;
+
+    int16_t word;
+    while(cin >> hex >> word){
+        request.input.push_back(word);
+    }
+
+    // Loads the image once, then times runs naming it only
+    int fd = connectTo(socketPath);
+    if(fd < 0 || !call(fd, request, reply)){
+        cerr << MainMessages::badServer << endl;
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    if(requests == 0){
+        for(int16_t w : reply.output){
+            cout << right << setw(4) << setfill('0') << hex << w << "  " << endl;
+        }
+        const char* names[SERVER_REGISTERS] = { "AX", "BX", "CX", "SP", "BP", "IP", "ZF", "SF" };
+        cerr << (reply.status == SERVER_HALTED ? "halted" : "stopped") << " after " << dec << reply.executed << " instructions:";
+        for(int r = 0; r < SERVER_REGISTERS; r++){
+            cerr << ' ' << names[r] << '=' << hex << setw(4) << setfill('0') << reply.registers[r];
+        }
+        cerr << endl;
+        return reply.status == SERVER_HALTED ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    request.kind = SERVER_RUN_ID;
+    vector< vector<double> > latencies(connections);
+    vector<char> ok(connections, 0);
+    vector<thread> clients;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t c = 0; c < connections; c++){
+        size_t count = requests / connections + (c < requests % connections ? 1 : 0);
+        clients.push_back(thread([&, c, count]{
+            ok[c] = loadConnection(socketPath, request, count, depth, latencies[c]);
+        }));
+    }
+    for(thread& t : clients){
+        t.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> all;
+    for(size_t c = 0; c < connections; c++){
+        if(!ok[c]){
+            cerr << MainMessages::badServer << endl;
+            exit(EXIT_FAILURE);
+        }
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    }
+    sort(all.begin(), all.end());
+    cout << all.size() << " requests in " << seconds << " s: " << all.size() / seconds << " requests/s" << endl;
+    if(!all.empty()){
+        cout << "latency us: p50 " << all[all.size() / 2] << ", p99 " << all[all.size() * 99 / 100] << ", max " << all.back() << endl;
+    }
+    return EXIT_SUCCESS;
+}
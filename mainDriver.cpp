@@ -0,0 +1,161 @@
+/* Simple86 driver main
+ *
+ * Entry point for a program that mounts, links and runs Simple86 sources
+ * in one process: simple86 run [-O] [-j N] a.asm b.asm ...
+ * Objects and the executable are kept in memory, never written to disk,
+ * and the time each stage took is written to cerr.
+ *
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <chrono>
+#include "Mounter.h"
+#include "Linker.h"
+#include "Archive.h"
+#include "ThreadPool.h"
+#include "Memory.h"
+#include "Execute.h"
+#include "FetchAndDecode.h"
+
+using namespace std;
+
+// Output messages in case of error.
+class MainMessages{
+    public:
+        const static string noSource;
+        const static string badInput;
+        const static string badIO;
+        const static string badLink;
+};
+
+const string MainMessages::noSource = "Usage: simple86 run [-O] [-j N] sources... (archives are linked as libraries).";
+const string MainMessages::badInput = "The arguments are not in the expected format.";
+const string MainMessages::badIO = "Could not open or create files. An error has occurred while performing required IO operations.";
+const string MainMessages::badLink = "Could not link the program, some names are not defined.";
+
+/* ------------------------------------------------------------------------
+* double millisecondsSince(chrono::steady_clock::time_point start)
+* Time elapsed since start, in milliseconds.
+* ------------------------------------------------------------------------ */
+double millisecondsSince(chrono::steady_clock::time_point start){
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/* ------------------------------------------------------------------------
+* Memory* loadExecutable(const string& image)
+* Loads an executable, as the linker wrote it, into a new machine memory:
+* the first word is the entry point, the following ones the program.
+* ------------------------------------------------------------------------ */
+Memory* loadExecutable(const string& image){
+    Memory* memory = new Memory();
+    size_t words = image.size() / 2;
+    int16_t word;
+
+    if(words == 0){
+        return memory;
+    }
+    memcpy(&word, image.data(), sizeof(int16_t));
+    memory->setRegister(Memory::Register::IP, word);
+    for(size_t i = 1; i < words && i <= MEMORY_LIMIT; i++){
+        memcpy(&word, image.data() + 2 * i, sizeof(int16_t));
+        memory->writeMemory(i - 1, word);
+    }
+    return memory;
+}
+
+/* ------------------------------------------------------------------------
+* int main(int argc, char* argv[])
+* Reads the arguments, mounts each source into an in-memory object, links
+* the objects, and any archives given, into an in-memory executable and
+* runs it. -O optimizes each source as the mounter's -O does, -j N mounts
+* and links with N threads (0, the default, is one per hardware thread).
+* ------------------------------------------------------------------------ */
+int main(int argc, char* argv[]){
+    vector<string> sources, modules;
+    bool optimizeEnabled = false;
+    unsigned int jobs = 0;
+
+    if(argc < 3 || strcmp(argv[1], "run") != 0){
+        cerr << MainMessages::noSource << endl;
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 2; i < argc; i++){
+        if(strcmp(argv[i], "-O") == 0){
+            optimizeEnabled = true;
+        }else if(strcmp(argv[i], "-j") == 0){
+            if(i + 1 >= argc){
+                cerr << MainMessages::badInput << endl;
+                exit(EXIT_FAILURE);
+            }
+            jobs = (unsigned int)atoi(argv[++i]);
+        }else{
+            sources.push_back(string(argv[i]));
+        }
+    }
+    if(sources.empty()){
+        cerr << MainMessages::noSource << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    ThreadPool* pool = new ThreadPool(jobs);
+    vector<string> objects(sources.size());
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // Mounts each source into its object, archives go to the linker as they are
+    for(size_t s = 0; s < sources.size(); s++){
+        if(Archive::isArchive(sources[s])){
+            modules.push_back(sources[s]);
+            continue;
+        }
+        ifstream input(sources[s].c_str());
+        ostringstream output(ios::out|ios::binary);
+        if(!input.is_open()){
+            cerr << MainMessages::badIO << endl;
+            exit(EXIT_FAILURE);
+        }
+        Mounter comp(&input, &output, false, &cerr, pool, optimizeEnabled);
+        comp.mount();
+        objects[s] = output.str();
+        modules.push_back(sources[s]);
+    }
+    cerr << "mount: " << millisecondsSince(start) << " ms" << endl;
+
+    // Links the objects from memory
+    start = chrono::steady_clock::now();
+    ostringstream executable(ios::out|ios::binary);
+    Linker* linker = new Linker(modules, &executable, false, jobs);
+    for(size_t s = 0; s < sources.size(); s++){
+        if(!objects[s].empty()){
+            linker->provideModule(sources[s], &objects[s]);
+        }
+    }
+    if(!linker->link()){
+        cerr << MainMessages::badLink << endl;
+        exit(EXIT_FAILURE);
+    }
+    delete linker;
+    cerr << "link: " << millisecondsSince(start) << " ms" << endl;
+
+    // Runs the executable from memory
+    start = chrono::steady_clock::now();
+    string image = executable.str();
+    Memory* memory = loadExecutable(image);
+    Execute* execute = new Execute(memory);
+    FetchAndDecode* fetchAndDecode = new FetchAndDecode(memory, execute);
+    fetchAndDecode->initMachine();
+    cout.flush();
+    cerr << "run: " << millisecondsSince(start) << " ms" << endl;
+
+    delete fetchAndDecode;
+    delete execute;
+    delete memory;
+    delete pool;
+    return EXIT_SUCCESS;
+}
@@ -8,42 +8,165 @@
 #include <cstdlib>
 #include <cstdio>
 #include <iostream>
+#include <cstring>
 #include <inttypes.h>
 #include "Memory.h"
 #include "Execute.h"
 #include "FetchAndDecode.h"
+#include "Profile.h"
+#include "Predecoded.h"
+#include "Scheduler.h"
+#include "AsyncConsole.h"
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <iomanip>
 
 /* ------------------------------------------------------------------------
- * Memory *populateMemory(char* file)
+ * Memory *populateMemory(char* file, uint64_t programBytes, int32_t size)
  * Reads a binary input file, containing a Simple86 program, and populates
- * the machine memory with it.
+ * a machine memory of size words with it. Only the first programBytes bytes
+ * of the file are the program, a predecoded section may follow.
  * ------------------------------------------------------------------------ */
-Memory* populateMemory(char* file) {
-    Memory* memory = new Memory();
-    int16_t i;
-    int16_t numInst;
-    int16_t bufferIn[MEMORY_LIMIT] = { 0 };
+Memory* populateMemory(char* file, uint64_t programBytes, int32_t size) {
+    Memory* memory = new Memory(size);
+    int32_t i;
+    int32_t numInst;
+    std::vector<int16_t> bufferIn(size, 0);
     int16_t ip;
 
     FILE* fIn = fopen(file, "r");
     fread(&ip, 2, 1, fIn);
     memory->setRegister(Memory::Register::IP, ip);
-    numInst = (int16_t)fread((void*)bufferIn, 2, MEMORY_LIMIT, fIn);
+    numInst = (int32_t)fread((void*)bufferIn.data(), 2, programBytes / 2 - 1 < (uint64_t)size ? programBytes / 2 - 1 : size, fIn);
     fclose(fIn);
 
 
     for (i = 0; i < numInst; i++) {
-        memory->writeMemory(i, bufferIn[i]);
+        memory->writeMemory((int16_t)i, bufferIn[i]);
     }
 
     return memory;
 }
 
+/* ------------------------------------------------------------------------
+* void runSessions(Memory* loaded, PredecodedImage* image, uint32_t sessions, uint64_t quantum)
+* Runs sessions copies of the loaded program on this thread, switching
+* between them every quantum instructions. Input lines "machine word", the
+* machine in decimal, the word in hexadecimal, go to that machine as they
+* come; a machine waiting for input doesn't hold the others. Each word
+* written is printed as "machine word", each halt as "machine halted".
+* ------------------------------------------------------------------------ */
+void runSessions(Memory* loaded, PredecodedImage* image, uint32_t sessions, uint64_t quantum) {
+    OutputChannel channel;
+    Scheduler* scheduler = new Scheduler(&channel, quantum);
+    std::atomic<bool> inputDone(false);
+
+    for (uint32_t s = 0; s < sessions; s++) {
+        if (image->hasSection()) {
+            scheduler->add(new Memory(*loaded), image->instructions(), image->recordCount() < (uint32_t)loaded->getSize() ? image->recordCount() : loaded->getSize());
+        } else {
+            scheduler->add(new Memory(*loaded));
+        }
+    }
+
+    // Prints the output as the machines post it.
+    std::thread printer([&channel]() {
+        std::vector<OutputEvent> events;
+        while (channel.take(events)) {
+            for (OutputEvent& e : events) {
+                std::cout << std::dec << e.machine;
+                if (e.halted) {
+                    std::cout << " halted" << std::endl;
+                } else {
+                    std::cout << ' ' << std::right << std::setw(4) << std::setfill('0') << std::hex << e.word << std::endl;
+                }
+            }
+        }
+    });
+
+    // Delivers the input as it comes, and closes every input at its end.
+    std::thread reader([scheduler, sessions, &inputDone]() {
+        uint32_t machine;
+        int16_t word;
+        while (std::cin >> std::dec >> machine >> std::hex >> word) {
+            if (machine < sessions) {
+                scheduler->deliver(machine, word);
+            }
+        }
+        for (uint32_t s = 0; s < sessions; s++) {
+            scheduler->closeInput(s);
+        }
+        inputDone = true;
+    });
+
+    while (scheduler->runUntilIdle()) {
+        scheduler->waitForMail();
+    }
+    channel.close();
+    printer.join();
+
+    // If every machine halted before the input ended, the reader is left
+    // blocked on it, and the scheduler to it, until the process exits.
+    if (inputDone) {
+        reader.join();
+        delete scheduler;
+    } else {
+        reader.detach();
+    }
+}
+
+/* ------------------------------------------------------------------------
+* void runHarts(Memory* loaded, uint32_t harts, int16_t stackWords, Console* console)
+* Runs the loaded program on harts harts at once, each on a thread of its
+* own with registers of its own, all sharing the words of loaded. Hart h
+* starts at the program's entry, with its stack at the memory's end minus h
+* times stackWords. The harts share console, or the standard streams, and
+* the machine stops once every hart halted. The predecoded records are not
+* used: a hart can't tell another one wrote over the code.
+* ------------------------------------------------------------------------ */
+void runHarts(Memory* loaded, uint32_t harts, int16_t stackWords, Console* console) {
+    StreamConsole standardConsole;
+    SharedConsole shared(console != nullptr ? console : &standardConsole);
+    std::vector<Memory*> memories;
+    std::vector<Execute*> executes;
+    std::vector<FetchAndDecode*> machines;
+    std::vector<std::thread> threads;
+
+    for (uint32_t h = 0; h < harts; h++) {
+        memories.push_back(new Memory(loaded, (int16_t)h, (int16_t)harts, (int16_t)(loaded->getSize() - h * stackWords)));
+        executes.push_back(new Execute(memories[h], &shared));
+        machines.push_back(new FetchAndDecode(memories[h], executes[h]));
+    }
+    for (uint32_t h = 0; h < harts; h++) {
+        threads.push_back(std::thread(&FetchAndDecode::initMachine, machines[h]));
+    }
+    for (uint32_t h = 0; h < harts; h++) {
+        threads[h].join();
+        delete machines[h];
+        delete executes[h];
+        delete memories[h];
+    }
+}
+
 /* ------------------------------------------------------------------------
 * int main(int argc, char* argv[])
 * Entry point. Receives the address of the file, containing the program to be
 * executed in the emulator, as a argument. If no argument is specified, returns,
 * else mounts the machine, loads the program and begins it's execution.
+* With --profile FILE, an execution profile is written to FILE at the end,
+* only for a single machine.
+* With --sessions N, N copies of the program run at once, see runSessions,
+* switching every --quantum instructions (1000 by default).
+* With --async-output FILE, the output is formatted and written to FILE, or
+* to the standard output if FILE is -, by a thread of its own.
+* With --harts N, N harts run the program on shared memory, see runHarts,
+* each with a stack of --hart-stack words (64 by default).
+* With --mmio WORDS, the single machine gets an output device of WORDS words
+* at the top of its memory, see Memory.h, its doorbell at the last word.
+* With --memory WORDS, the machines have WORDS words of memory, up to
+* MEMORY_MAX_WORDS, instead of MEMORY_LIMIT.
 * ------------------------------------------------------------------------ */
 int main(int argc, char* argv[]) {
     if (argc < 2) {
@@ -51,13 +174,116 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    // Machine is instantiated.
-    Memory* memory = populateMemory(argv[1]);
-    Execute* execute = new Execute(memory);
-    FetchAndDecode* fetchAndDecode = new FetchAndDecode(memory, execute);
+    Profile* profile = nullptr;
+    const char* profileName = nullptr;
+    uint32_t sessions = 0;
+    uint64_t quantum = 1000;
+    const char* asyncName = nullptr;
+    uint32_t harts = 0;
+    int16_t hartStack = 64;
+    int16_t deviceWords = 0;
+    int32_t memoryWords = MEMORY_LIMIT;
+    // Each flag takes the word after it as its value, skipped past.
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0) {
+            profileName = argv[++i];
+        } else if (strcmp(argv[i], "--sessions") == 0) {
+            sessions = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--quantum") == 0) {
+            quantum = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--async-output") == 0) {
+            asyncName = argv[++i];
+        } else if (strcmp(argv[i], "--harts") == 0) {
+            harts = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--hart-stack") == 0) {
+            hartStack = (int16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mmio") == 0) {
+            deviceWords = (int16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--memory") == 0) {
+            memoryWords = (int32_t)atol(argv[++i]);
+        }
+    }
+    if (profileName != nullptr && (sessions > 0 || harts > 0)) {
+        std::cout << "A profile is only taken of a single machine, not with --sessions or --harts" << std::endl;
+        return 0;
+    }
+    if (deviceWords > 0 && (sessions > 0 || harts > 0)) {
+        std::cout << "An output device is only mapped for a single machine, not with --sessions or --harts" << std::endl;
+        return 0;
+    }
+    if (memoryWords <= 0 || memoryWords > MEMORY_MAX_WORDS) {
+        std::cout << "The memory must have from 1 to " << MEMORY_MAX_WORDS << " words" << std::endl;
+        return 0;
+    }
+    if (harts > 255 || (harts > 0 && (hartStack <= 0 || (int32_t)harts * hartStack > memoryWords))) {
+        std::cout << "Harts must be at most 255, and their stacks fit in the memory" << std::endl;
+        return 0;
+    }
+
+    // Machine is instantiated. If the linker predecoded the program, the
+    // machine runs from the predecoded records, mapped from the file.
+    if (profileName != nullptr) {
+        profile = new Profile(memoryWords);
+    }
+    PredecodedImage* image = new PredecodedImage(argv[1]);
+    Memory* memory = populateMemory(argv[1], image->programBytes(), memoryWords);
+    if (sessions > 0) {
+        runSessions(memory, image, sessions, quantum);
+        delete profile;
+        delete image;
+        delete memory;
+        return 0;
+    }
+    std::ofstream* asyncFile = nullptr;
+    AsyncConsole* console = nullptr;
+    if (asyncName != nullptr && strcmp(asyncName, "-") != 0) {
+        asyncFile = new std::ofstream(asyncName);
+        if (!asyncFile->is_open()) {
+            std::cout << "Could not write the output to " << asyncName << std::endl;
+            return 0;
+        }
+        console = new AsyncConsole(asyncFile);
+    } else if (asyncName != nullptr) {
+        console = new AsyncConsole(&std::cout);
+    }
+    if (harts > 0) {
+        runHarts(memory, harts, hartStack, console);
+        delete console;
+        delete asyncFile;
+        delete profile;
+        delete image;
+        delete memory;
+        return 0;
+    }
+    // The device writes where WRITE does, through the same console
+    StreamConsole* standardConsole = nullptr;
+    if (deviceWords > 0) {
+        if ((int64_t)image->programBytes() / 2 - 1 > memoryWords - 1 - deviceWords) {
+            std::cout << "The program doesn't fit below the output device" << std::endl;
+            return 0;
+        }
+        if (console == nullptr) {
+            standardConsole = new StreamConsole();
+        }
+        memory->mapOutput(console != nullptr ? (Console*)console : standardConsole, deviceWords);
+    }
+    Execute* execute = new Execute(memory, console != nullptr ? (Console*)console : standardConsole);
+    FetchAndDecode* fetchAndDecode = new FetchAndDecode(memory, execute, profile);
+    if (image->hasSection()) {
+        fetchAndDecode->usePredecoded(image->instructions(), image->recordCount() < (uint32_t)memoryWords ? image->recordCount() : memoryWords);
+    }
 
     // Machine execution started.
     fetchAndDecode->initMachine();
+    delete console;
+    delete asyncFile;
+    delete standardConsole;
+
+    if (profile != nullptr && !profile->write(profileName)) {
+        std::cout << "Could not write the profile to " << profileName << std::endl;
+    }
+    delete profile;
+    delete image;
 
     delete execute;
     delete fetchAndDecode;
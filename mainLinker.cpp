@@ -11,6 +11,8 @@
 #include <cstring>
 #include <cstdlib>
 #include "Linker.h"
+#include "Archive.h"
+#include "BuildCache.h"
 
 using namespace std;
 
@@ -20,11 +22,13 @@ class MainMessages{
         const static string noSource;
         const static string badInput;
         const static string badIO;
+        const static string badLink;
 };
 
 const string MainMessages::noSource = "Args must contain at least the address of the source code to be compiled.";
 const string MainMessages::badInput = "The arguments are not in the expected format.";
 const string MainMessages::badIO = "Could not open or create files. An error has occurred while performing required IO operations.";
+const string MainMessages::badLink = "Could not link the program, some names are not defined.";
 
 /* ------------------------------------------------------------------------
 * int main(int argc, char* argv[])
@@ -33,6 +37,13 @@ const string MainMessages::badIO = "Could not open or create files. An error has
 * ------------------------------------------------------------------------ */
 int main (int argc, char *argv[]){
     bool verboseEnabled = false;
+    bool gcEnabled = false;
+    size_t inlineBudget = 0;
+    string profileName = "";
+    bool archiveEnabled = false;
+    bool predecodeEnabled = false;
+    unsigned int jobs = 0;
+    BuildCache* cache = nullptr;
     ofstream* output;
     Linker* comp;
     vector<string> inputFiles;
@@ -45,27 +56,70 @@ int main (int argc, char *argv[]){
     // First arg is the output file
     output = new ofstream(argv[1],ios::binary);
 
-    // The rest is eighter -v, meaning verbose mode, or
-    // module files to be merged into a single binary
+    // The rest is eighter -v, meaning verbose mode, -j N, the number
+    // of threads to use, --cache DIR, the build cache to use, --gc, to
+    // drop what can't be reached, --inline BYTES, to inline routines up
+    // to that size, --profile-use FILE, a profile written by the emulator
+    // to optimize for, --archive, to bundle the modules into an archive
+    // instead of linking them, --predecode, to add the predecoded section
+    // the emulator runs from, or module files (or archives) to be merged
+    // into a single binary
     for(int i = 2; i < argc; i++){
         if(strcmp(argv[i],"-v") == 0){
             verboseEnabled = true;
+        }else if(strcmp(argv[i],"-j") == 0 && i + 1 < argc){
+            jobs = atoi(argv[i+1]);
+            i++;
+        }else if(strcmp(argv[i],"--cache") == 0 && i + 1 < argc){
+            cache = new BuildCache(string(argv[i+1]));
+            i++;
+        }else if(strcmp(argv[i],"--inline") == 0 && i + 1 < argc){
+            inlineBudget = atoi(argv[i+1]);
+            i++;
+        }else if(strcmp(argv[i],"--profile-use") == 0 && i + 1 < argc){
+            profileName = string(argv[i+1]);
+            i++;
+        }else if(strcmp(argv[i],"--archive") == 0){
+            archiveEnabled = true;
+        }else if(strcmp(argv[i],"--predecode") == 0){
+            predecodeEnabled = true;
+        }else if(strcmp(argv[i],"--gc") == 0){
+            gcEnabled = true;
         }else{
             inputFiles.push_back(string(argv[i]));
         }
     }
 
     // Are the files ok?
-    if(output->is_open()){
+    if(output->is_open() && archiveEnabled){
+        string error;
+        if(!Archive::write(*output, inputFiles, error)){
+            cerr << error << endl;
+            exit(EXIT_FAILURE);
+        }
+        output->close();
+        delete cache;
+        delete output;
+        return EXIT_SUCCESS;
+    }else if(output->is_open()){
     	// Initializes the linker and begins the process
-        comp = new Linker(inputFiles, output, verboseEnabled);
-        comp->link();
+        comp = new Linker(inputFiles, output, verboseEnabled, jobs, cache, gcEnabled, inlineBudget, profileName);
+        if(predecodeEnabled){
+            comp->enablePredecoded();
+        }
+        if(!comp->link()){
+            cerr << MainMessages::badLink << endl;
+            output->close();
+            exit(EXIT_FAILURE);
+        }
+        output->close();
     }else{
         cerr << MainMessages::badIO;
         exit(EXIT_FAILURE);
     }
 
     delete comp;
+    delete cache;
     delete output;
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -10,7 +10,11 @@
 #include <string>
 #include <cstring>
 #include <cstdlib>
+#include <sstream>
+#include <vector>
 #include "Mounter.h"
+#include "BuildCache.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
@@ -26,18 +30,104 @@ const string MainMessages::noSource = "Args must contain at least the address of
 const string MainMessages::badInput = "The arguments are not in the expected format.";
 const string MainMessages::badIO = "Could not open or create files. An error has occurred while performing required IO operations.";
 
+/* ------------------------------------------------------------------------
+* string outputNameFor(string inputName, string directory)
+* Names the object of a source when many are mounted at once: the source's
+* name with the extension replaced by .sa, inside directory, or next to the
+* source if no directory was given.
+* ------------------------------------------------------------------------ */
+string outputNameFor(string inputName, string directory){
+    size_t slash = inputName.find_last_of('/');
+    string base = slash == string::npos ? inputName : inputName.substr(slash + 1);
+    size_t dot = base.find_last_of('.');
+
+    if(dot != string::npos && dot > 0){
+        base = base.substr(0, dot);
+    }
+    if(directory.empty()){
+        return (slash == string::npos ? "" : inputName.substr(0, slash + 1)) + base + ".sa";
+    }
+    return directory + '/' + base + ".sa";
+}
+
+/* ------------------------------------------------------------------------
+* bool mountFile(string inputName, string outputName, bool verboseEnabled, bool streamingEnabled,
+*                bool optimizeEnabled, BuildCache* cache, ThreadPool* pool, ostream& log, string& error)
+* Mounts one source into one object, writing the verbose output to log. The
+* source is split among the pool's threads, if there is a pool, or, with
+* streamingEnabled, no verbose output and no optimizer, mounted in a single
+* pass. If something goes wrong, returns false and describes it in error.
+* Safe to call for different files at the same time.
+* ------------------------------------------------------------------------ */
+bool mountFile(string inputName, string outputName, bool verboseEnabled, bool streamingEnabled, bool optimizeEnabled, BuildCache* cache, ThreadPool* pool, ostream& log, string& error){
+    ifstream input(inputName.c_str());
+    ofstream output(outputName.c_str(),ios::out|ios::binary);
+    string key, object;
+
+    // Are the files ok?
+    if(!input.is_open() || !output.is_open()){
+        error = MainMessages::badIO;
+        return false;
+    }
+
+    // The object depends only on the source text, an unchanged source is
+    // taken from the cache instead of being mounted again
+    if(cache != nullptr){
+        ostringstream buffer;
+        buffer << input.rdbuf();
+        key = cache->keyFor(optimizeEnabled ? "mounter-O" : "mounter", buffer.str().data(), buffer.str().size());
+        input.clear();
+        input.seekg(0);
+        if(cache->load(key, object)){
+            output.write(object.data(), object.size());
+            output.close();
+            if(verboseEnabled){
+                log << "Object taken from the build cache (" << key << ")" << endl;
+            }
+            return true;
+        }
+    }
+
+    try{
+        Mounter comp(&input, &output, verboseEnabled, &log, pool, optimizeEnabled);
+        if(streamingEnabled && !verboseEnabled && !optimizeEnabled){
+            comp.mountStreaming();
+        }else{
+            comp.mount();
+        }
+        input.close();
+        output.close();
+    }catch(exception& e){
+        error = string("Could not be mounted (") + e.what() + ").";
+        return false;
+    }
+
+    if(cache != nullptr){
+        ifstream written(outputName.c_str(), ios::in|ios::binary);
+        ostringstream buffer;
+        buffer << written.rdbuf();
+        cache->store(key, buffer.str());
+    }
+    return true;
+}
+
 /* ------------------------------------------------------------------------
 * int main(int argc, char* argv[])
 * Accepts arguments in different orders, initializes the compiler based on
-* those.
+* those. Many sources can be given, they are mounted at the same time, each
+* one into its own object, named after it (see outputNameFor).
 * ------------------------------------------------------------------------ */
 int main (int argc, char *argv[]){
     bool verboseEnabled = false;
-    string outputName = "exec.sa";
-    string inputName = "";
-    ifstream* input;
-    ofstream* output;
-    Mounter* comp;
+    bool streamingEnabled = false;
+    bool optimizeEnabled = false;
+    bool allMounted = true;
+    string outputName = "";
+    string outputDirectory = "";
+    string cacheDirectory = "";
+    unsigned int jobs = 0;
+    vector<string> inputNames;
+    BuildCache* cache = nullptr;
 
     if(argc < 2){
         cerr << MainMessages::noSource;
@@ -47,33 +137,70 @@ int main (int argc, char *argv[]){
     for(int i = 1; i < argc; i++){
         if(strcmp(argv[i],"-v") == 0){
             verboseEnabled = true;
-        } else if(strcmp(argv[i],"-o") == 0){
+        } else if(strcmp(argv[i],"-s") == 0){
+            streamingEnabled = true;
+        } else if(strcmp(argv[i],"-O") == 0){
+            optimizeEnabled = true;
+        } else if(strcmp(argv[i],"-o") == 0 && i + 1 < argc){
             outputName = string(argv[i+1]);
             i++;
+        } else if(strcmp(argv[i],"-d") == 0 && i + 1 < argc){
+            outputDirectory = string(argv[i+1]);
+            i++;
+        } else if(strcmp(argv[i],"-j") == 0 && i + 1 < argc){
+            jobs = atoi(argv[i+1]);
+            i++;
+        } else if(strcmp(argv[i],"--cache") == 0 && i + 1 < argc){
+            cacheDirectory = string(argv[i+1]);
+            i++;
         } else{
-            inputName = string(argv[i]);
+            inputNames.push_back(string(argv[i]));
         }
     }
 
-    if(inputName.empty()){
+    // -o names the object of a single source
+    if(inputNames.empty() || (inputNames.size() > 1 && !outputName.empty())){
         cerr << MainMessages::badInput;
         exit(EXIT_FAILURE);
     }
+    if(inputNames.size() == 1 && outputName.empty()){
+        outputName = outputDirectory.empty() ? "exec.sa" : outputNameFor(inputNames[0], outputDirectory);
+    }
 
-    input = new ifstream(inputName.c_str());
-    output = new ofstream(outputName.c_str(),ios::out|ios::binary);
+    if(!cacheDirectory.empty()){
+        cache = new BuildCache(cacheDirectory);
+    }
 
-    // Are the files ok?
-    if(input->is_open() && output->is_open()){
-        comp = new Mounter(input, output, verboseEnabled);
-        comp->mount();
+    // Each source has its own verbose output and error, shown in the order
+    // the sources were given once all are mounted. Many sources are mounted
+    // at the same time, a single one is split among the threads instead.
+    vector<ostringstream> logs(inputNames.size());
+    vector<string> errors(inputNames.size());
+    vector<char> mounted(inputNames.size(), 0);
+    ThreadPool pool(jobs);
+
+    if(inputNames.size() == 1){
+        mounted[0] = mountFile(inputNames[0], outputName, verboseEnabled, streamingEnabled, optimizeEnabled, cache, &pool, logs[0], errors[0]);
     }else{
-        cerr << MainMessages::badIO;
-        exit(EXIT_FAILURE);
+        pool.parallelFor(inputNames.size(), [&](size_t begin, size_t end){
+            for(size_t k = begin; k < end; k++){
+                string name = outputNameFor(inputNames[k], outputDirectory);
+                mounted[k] = mountFile(inputNames[k], name, verboseEnabled, streamingEnabled, optimizeEnabled, cache, nullptr, logs[k], errors[k]);
+            }
+        });
+    }
+
+    for(size_t k = 0; k < inputNames.size(); k++){
+        if(verboseEnabled && inputNames.size() > 1){
+            cout << inputNames[k] << ":" << endl;
+        }
+        cout << logs[k].str();
+        if(!mounted[k]){
+            cerr << inputNames[k] << ": " << errors[k] << endl;
+            allMounted = false;
+        }
     }
 
-    delete comp;
-    delete input;
-    delete output;
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    delete cache;
+    return allMounted ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,80 @@
+/* Simple86_Server main
+ *
+ * Entry point for the long-lived emulator server:
+ * Simple86_Server [--socket PATH] [-j N] [--cache IMAGES] [--budget INSTRUCTIONS] [--slice INSTRUCTIONS]
+ * Serves the requests of ServerProtocol.h on a Unix domain socket
+ * or, without --socket, on its standard input and output.
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include "Server.h"
+
+using namespace std;
+
+// Output messages in case of error.
+class MainMessages{
+    public:
+        const static string badInput;
+        const static string badSocket;
+};
+
+const string MainMessages::badInput = "Usage: Simple86_Server [--socket PATH] [-j N] [--cache IMAGES] [--budget INSTRUCTIONS] [--slice INSTRUCTIONS]";
+const string MainMessages::badSocket = "Could not listen on the socket.";
+
+/* ------------------------------------------------------------------------
+* int main(int argc, char* argv[])
+* Reads the options and serves until killed, or, on the standard streams,
+* until the client closes the input. -j sets the workers running requests,
+* --cache the images kept decoded (64 by default), --budget the most
+* instructions a request may run (10000000 by default, 0 for no limit) and
+* --slice the instructions a request runs before giving its worker to the
+* next one (10000 by default).
+* ------------------------------------------------------------------------ */
+int main(int argc, char* argv[]){
+    string socketPath;
+    unsigned int jobs = 0;
+    size_t capacity = 64;
+    uint64_t budget = 10000000;
+    uint64_t slice = 10000;
+
+    for(int i = 1; i < argc; i++){
+        if(i + 1 >= argc){
+            cerr << MainMessages::badInput << endl;
+            exit(EXIT_FAILURE);
+        }
+        if(strcmp(argv[i], "--socket") == 0){
+            socketPath = argv[++i];
+        }else if(strcmp(argv[i], "-j") == 0){
+            jobs = (unsigned int)atoi(argv[++i]);
+        }else if(strcmp(argv[i], "--cache") == 0){
+            capacity = (size_t)atol(argv[++i]);
+        }else if(strcmp(argv[i], "--budget") == 0){
+            budget = strtoull(argv[++i], nullptr, 10);
+        }else if(strcmp(argv[i], "--slice") == 0){
+            slice = strtoull(argv[++i], nullptr, 10);
+        }else{
+            cerr << MainMessages::badInput << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // A client going away must not take the server with it
+    signal(SIGPIPE, SIG_IGN);
+
+    Server* server = new Server(jobs, capacity, budget, slice);
+    if(socketPath.empty()){
+        server->serveStreams(0, 1);
+    }else if(!server->serveSocket(socketPath)){
+        cerr << MainMessages::badSocket << endl;
+        delete server;
+        exit(EXIT_FAILURE);
+    }
+
+    delete server;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,17 @@
+MOV BX, 0x80
+ADD BX, BX
+ADD BX, BX
+ADD BX, BX
+ADD BX, BX
+ADD BX, BX
+ADD BX, BX
+ADD BX, BX
+ADD BX, BX
+WRITE BX
+MOV [BX+0x10], 0x5
+MOV AX, 0x6
+PUSH AX
+POP CX
+WRITE [BX+0x10]
+WRITE CX
+HLT
\ No newline at end of file
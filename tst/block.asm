@@ -0,0 +1,30 @@
+MOV AX, 0x7
+MOV BX, 0x80
+MOV CX, 0x10
+STOS
+WRITE BX
+WRITE CX
+MOV AX, 0x80
+MOV BX, 0xa0
+MOV CX, 0x10
+MOVS
+MOV BX, 0x0
+WRITE [BX+0xaf]
+MOV BX, 0x80
+MOV [BX], 0x9
+MOV AX, 0x80
+MOV BX, 0x81
+MOV CX, 0x3
+MOVS
+MOV BX, 0x0
+WRITE [BX+0x81]
+WRITE [BX+0x83]
+MOV AX, 0x5
+MOV BX, 0xf8
+ADD BX, BX
+ADD BX, BX
+MOV CX, 0x20
+STOS
+WRITE BX
+WRITE CX
+HLT
\ No newline at end of file
@@ -0,0 +1,29 @@
+MOV BX, 0x80
+MOV CX, 0x6
+_fill:
+MOV [BX], CX
+ADD BX, 0x1
+SUB CX, 0x1
+JZ _go
+JMP _fill
+_go:
+MOV BX, 0x80
+MOV CX, 0x6
+HCALL 0x1
+MOV BX, 0x80
+WRITE [BX]
+WRITE [BX+0x1]
+WRITE [BX+0x5]
+MOV AX, 0x80
+MOV BX, 0x81
+MOV CX, 0x3
+HCALL 0x0
+WRITE AX
+MOV BX, 0x80
+MOV CX, 0x2
+HCALL 0x2
+WRITE AX
+MOV AX, 0x1
+HCALL 0x63
+WRITE AX
+HLT
\ No newline at end of file
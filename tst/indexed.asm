@@ -0,0 +1,32 @@
+DW _a
+DW _a1
+DW _n
+DW _b
+MOV _n, 0x5
+MOV BX, 0x0
+MOV [BX+_a], 0x7
+MOV BX, 0x1
+MOV [BX+_a], 0x9
+MOV CX, 0x0
+_loop:
+MOV BX, CX
+WRITE [BX+_a]
+ADD CX, 0x1
+CMP CX, 0x2
+JZ _end
+JMP _loop
+_end:
+WRITE _n
+MOV _b, 0x3
+MOV BX, 0x0
+ADD [BX+_b], 0x1
+WRITE _b
+SUB [BX+_b], 0x2
+WRITE _b
+OR [BX+_b], 0x8
+WRITE _b
+AND [BX+_b], 0x6
+WRITE _b
+NOT [BX+_b]
+WRITE _b
+HLT
\ No newline at end of file
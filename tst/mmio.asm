@@ -0,0 +1,9 @@
+MOV BX, 0x0
+MOV [BX+0x3e3], 0x11
+MOV [BX+0x3e4], 0x22
+MOV [BX+0x3e5], 0x33
+MOV [BX+0x3e6], 0x44
+MOV [BX+0x3e7], 0x2
+MOV [BX+0x3e7], 0x4
+WRITE 0x0
+HLT
\ No newline at end of file
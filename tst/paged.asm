@@ -0,0 +1,11 @@
+MOV BX, 0x0
+MOV [BX+0x7ff], 0x1
+MOV [BX+0x800], 0x2
+MOV [BX+0x1800], 0x3
+MOV [BX+0xfffe], 0x4
+WRITE [BX+0x7ff]
+WRITE [BX+0x800]
+WRITE [BX+0x1800]
+WRITE [BX+0xfffe]
+WRITE [BX+0x2800]
+HLT
\ No newline at end of file
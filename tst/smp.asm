@@ -0,0 +1,41 @@
+DW _total
+DW _done
+MOV BX, 0xc8
+_loop:
+MOV AX, _total
+_retry:
+MOV CX, AX
+ADD CX, 0x1
+CAS _total, CX
+JZ _next
+JMP _retry
+_next:
+SUB BX, 0x1
+JZ _fin
+JMP _loop
+_fin:
+MOV AX, _done
+_again:
+MOV CX, AX
+ADD CX, 0x1
+CAS _done, CX
+JZ _after
+JMP _again
+_after:
+HART AX
+CMP AL, 0x0
+JZ _main
+HLT
+_main:
+MOV CX, 0x0
+MOV CL, AH
+FENCE
+_wait:
+CMP CX, _done
+JZ _out
+JMP _wait
+_out:
+WRITE _total
+XCHG AX, _done
+WRITE AX
+HLT
\ No newline at end of file